@@ -0,0 +1,60 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fs.h"
+#include "fcntl.h"
+
+#define CHUNK 8
+#define BIG_BLOCKS 2048
+#define FILL_BLOCKS 12288
+
+char buf[CHUNK * BSIZE];
+
+// Write a file of the given number of blocks.
+void writefile(char *name, int blocks)
+{
+    int fd = open(name, O_CREATE | O_WRONLY);
+    if(fd < 0)
+    {
+        printf(2, "ERROR: cannot create %s!\n", name);
+        exit();
+    }
+
+    for(int b = 0; b < blocks; b += CHUNK)
+    {
+        if(write(fd, buf, sizeof(buf)) != sizeof(buf))
+        {
+            printf(2, "ERROR: write to %s failed at block %d!\n", name, b);
+            exit();
+        }
+    }
+    close(fd);
+}
+
+// Create and remove a large file, printing the ticks each took.
+void create_rm(char *label)
+{
+    int start = uptime();
+    writefile("allocbig", BIG_BLOCKS);
+    int created = uptime() - start;
+
+    start = uptime();
+    unlink("allocbig");
+    int removed = uptime() - start;
+
+    printf(1, "%s: create %d ticks, rm %d ticks\n", label, created, removed);
+}
+
+int main(int argc, char *argv[])
+{
+    // Creating and removing a file should cost the same whether
+    // the disk is nearly empty or mostly full.
+    create_rm("empty disk");
+    writefile("allocfill1", FILL_BLOCKS);
+    writefile("allocfill2", FILL_BLOCKS);
+    create_rm("full disk");
+    unlink("allocfill1");
+    unlink("allocfill2");
+
+    exit();
+}
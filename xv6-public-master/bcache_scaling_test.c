@@ -0,0 +1,72 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "bench.h"
+
+#define BLOCKS 64
+#define BSIZE 512
+
+char buf[BSIZE];
+
+// readers, passes per reader
+int args[] = { 4, 50 };
+
+void name(char *s, int i)
+{
+    strcpy(s, "bcachetest0");
+    s[10] = '0' + i;
+}
+
+// Read file i from start to end, over and over.
+void job(int i)
+{
+    char file[16];
+
+    name(file, i);
+    for(int r = 0; r < args[1]; r++)
+    {
+        int fd = open(file, O_RDONLY);
+
+        while(read(fd, buf, BSIZE) == BSIZE)
+            ;
+        close(fd);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    char file[16];
+
+    benchargs(argc, argv, args, 2, "bcache_scaling_test [readers] [rounds]");
+    if(args[0] > 10)
+        args[0] = 10;
+
+    // One file per reader, small enough that all of them stay
+    // in the buffer cache, so the run measures cache lookups.
+    for(int i = 0; i < args[0]; i++)
+    {
+        name(file, i);
+        int fd = open(file, O_CREATE | O_RDWR);
+
+        if(fd < 0)
+        {
+            printf(2, "ERROR: cannot create %s!\n", file);
+            exit();
+        }
+        for(int b = 0; b < BLOCKS; b++)
+            write(fd, buf, BSIZE);
+        close(fd);
+    }
+
+    int elapsed = runjobs(args[0], job);
+    printrate(args[0], "readers", args[1] * BLOCKS, "blocks", elapsed);
+
+    for(int i = 0; i < args[0]; i++)
+    {
+        name(file, i);
+        unlink(file);
+    }
+
+    exit();
+}
@@ -0,0 +1,58 @@
+// Shared skeleton of the benchmark programs: optional integer
+// arguments, running jobs in parallel, and reporting a rate.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "bench.h"
+
+// Parse argv[1..] as up to n integers over the defaults in v[].
+// Print usage and exit if there are more arguments than that.
+void
+benchargs(int argc, char *argv[], int *v, int n, char *usage)
+{
+  int i;
+
+  if(argc > n + 1){
+    printf(2, "usage: %s\n", usage);
+    exit();
+  }
+  for(i = 1; i < argc; i++)
+    v[i - 1] = atoi(argv[i]);
+}
+
+// Fork n children that each run job(i) and exit, and wait
+// for that many children to exit, so the caller should have no
+// others that can exit meanwhile. Returns the ticks that took,
+// at least 1 so that callers can divide by it.
+int
+runjobs(int n, void (*job)(int))
+{
+  int i, pid, start, elapsed;
+
+  start = uptime();
+  for(i = 0; i < n; i++){
+    if((pid = fork()) < 0){
+      printf(2, "ERROR: fork failed!\n");
+      break;
+    }
+    if(pid == 0){
+      job(i);
+      exit();
+    }
+  }
+  for(; i > 0; i--)
+    wait();
+
+  elapsed = uptime() - start;
+  return elapsed > 0 ? elapsed : 1;
+}
+
+// Print "<jobs> <who> x <each> <what> in <ticks> ticks" and the
+// rate of <what> per tick over all jobs.
+void
+printrate(int jobs, char *who, int each, char *what, int ticks)
+{
+  printf(1, "%d %s x %d %s in %d ticks: %d %s per tick\n",
+         jobs, who, each, what, ticks, jobs * each / ticks, what);
+}
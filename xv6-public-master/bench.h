@@ -0,0 +1,4 @@
+// Shared skeleton of the benchmark programs, in bench.c.
+void benchargs(int argc, char *argv[], int *v, int n, char *usage);
+int runjobs(int n, void (*job)(int));
+void printrate(int jobs, char *who, int each, char *what, int ticks);
@@ -0,0 +1,113 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define NFILES 1000
+#define BATCH 100
+
+// File i's name, in a buffer of at least 8 bytes.
+void filename(char *name, int i)
+{
+    name[0] = 'f';
+    name[1] = '0' + i / 1000;
+    name[2] = '0' + i / 100 % 10;
+    name[3] = '0' + i / 10 % 10;
+    name[4] = '0' + i % 10;
+    name[5] = 0;
+}
+
+int main(int argc, char *argv[])
+{
+    char name[8];
+    struct stat st;
+
+    if(mkdir("bigdir") < 0 || chdir("bigdir") < 0)
+    {
+        printf(2, "ERROR: cannot make bigdir!\n");
+        exit();
+    }
+
+    // Creating the last files should cost about as much as the
+    // first ones, though each has to check the whole directory.
+    printf(1, "creating %d files, ticks per %d:", NFILES, BATCH);
+    for(int i = 0; i < NFILES; i += BATCH)
+    {
+        int start = uptime();
+        for(int j = i; j < i + BATCH; j++)
+        {
+            filename(name, j);
+            int fd = open(name, O_CREATE | O_RDWR);
+            if(fd < 0)
+            {
+                printf(2, "\nERROR: cannot create %s!\n", name);
+                exit();
+            }
+            close(fd);
+        }
+        printf(1, " %d", uptime() - start);
+    }
+    printf(1, "\n");
+
+    int start = uptime();
+    for(int i = 0; i < NFILES; i++)
+    {
+        filename(name, i);
+        if(stat(name, &st) < 0)
+        {
+            printf(2, "ERROR: cannot stat %s!\n", name);
+            exit();
+        }
+    }
+    printf(1, "%d lookups in %d ticks\n", NFILES, uptime() - start);
+
+    start = uptime();
+    for(int i = 0; i < NFILES; i++)
+    {
+        filename(name, i);
+        name[0] = 'g';
+        if(stat(name, &st) == 0)
+        {
+            printf(2, "ERROR: found missing file %s!\n", name);
+            exit();
+        }
+    }
+    printf(1, "%d failed lookups in %d ticks\n", NFILES, uptime() - start);
+
+    // Moving a file out of the indexed directory must update
+    // both it and the name cache.
+    filename(name, 0);
+    if(mkdir("sub") < 0 || move_file(name, "sub") < 0)
+    {
+        printf(2, "ERROR: cannot move %s to sub!\n", name);
+        exit();
+    }
+    if(stat(name, &st) == 0)
+    {
+        printf(2, "ERROR: %s still found after move!\n", name);
+        exit();
+    }
+    chdir("sub");
+    if(stat(name, &st) < 0 || unlink(name) < 0)
+    {
+        printf(2, "ERROR: %s not found in sub after move!\n", name);
+        exit();
+    }
+    chdir("..");
+    unlink("sub");
+
+    for(int i = 1; i < NFILES; i++)
+    {
+        filename(name, i);
+        if(unlink(name) < 0)
+        {
+            printf(2, "ERROR: cannot unlink %s!\n", name);
+            exit();
+        }
+    }
+    chdir("..");
+    if(unlink("bigdir") < 0)
+        printf(2, "ERROR: bigdir not empty after unlinking every file!\n");
+
+    exit();
+}
@@ -0,0 +1,95 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fs.h"
+#include "fcntl.h"
+
+#define CHUNK 8
+#define FILE_BLOCKS 4096
+
+char buf[CHUNK * BSIZE];
+
+// Print bytes over ticks (10ms each) as KB/s.
+void report(char *label, int bytes, int ticks)
+{
+    if(ticks == 0)
+        ticks = 1;
+
+    printf(1, "%s: %d KB in %d ticks, %d KB/s\n",
+           label, bytes / 1024, ticks, bytes / 1024 * 100 / ticks);
+}
+
+int main(int argc, char *argv[])
+{
+    int blocks = FILE_BLOCKS;
+
+    if(argc > 2)
+    {
+        printf(2, "usage: bigfile_test [blocks]\n");
+        exit();
+    }
+
+    if(argc > 1)
+        blocks = atoi(argv[1]);
+
+    if(blocks <= 0 || blocks > MAXFILE)
+    {
+        printf(2, "ERROR: at most %d blocks!\n", MAXFILE);
+        exit();
+    }
+
+    // Write a file well past the singly-indirect limit, tagging
+    // each block with its number.
+    int fd = open("bigfile", O_CREATE | O_RDWR);
+    if(fd < 0)
+    {
+        printf(2, "ERROR: cannot create bigfile!\n");
+        exit();
+    }
+
+    int start = uptime();
+    for(int b = 0; b < blocks; b += CHUNK)
+    {
+        int n = blocks - b < CHUNK ? blocks - b : CHUNK;
+
+        for(int i = 0; i < n; i++)
+            ((int*)buf)[i * BSIZE / sizeof(int)] = b + i;
+
+        if(write(fd, buf, n * BSIZE) != n * BSIZE)
+        {
+            printf(2, "ERROR: write failed at block %d!\n", b);
+            exit();
+        }
+    }
+    fsync(fd);
+    report("write", blocks * BSIZE, uptime() - start);
+    close(fd);
+
+    fd = open("bigfile", O_RDONLY);
+    start = uptime();
+    for(int b = 0; b < blocks; b += CHUNK)
+    {
+        int n = blocks - b < CHUNK ? blocks - b : CHUNK;
+
+        if(read(fd, buf, n * BSIZE) != n * BSIZE)
+        {
+            printf(2, "ERROR: read failed at block %d!\n", b);
+            exit();
+        }
+
+        for(int i = 0; i < n; i++)
+        {
+            if(((int*)buf)[i * BSIZE / sizeof(int)] != b + i)
+            {
+                printf(2, "ERROR: block %d has the wrong contents!\n", b + i);
+                exit();
+            }
+        }
+    }
+    report("read", blocks * BSIZE, uptime() - start);
+    close(fd);
+
+    unlink("bigfile");
+
+    exit();
+}
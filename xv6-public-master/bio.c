@@ -1,12 +1,18 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
 //
+// Each bucket has its own lock, so lookups of different blocks
+// rarely contend. A miss evicts the unused buffer released
+// longest ago; bcache.lock serializes misses so that two of
+// them can't insert the same block twice.
+//
 // Interface:
-// * To get a buffer for a particular disk block, call bread.
+// * To get a buffer for a particular disk block, call bread,
+//     or bnew if you are about to overwrite all of it.
 // * After changing buffer data, call bwrite to write it to disk.
 // * When done with the buffer, call brelse.
 // * Do not use the buffer after calling brelse.
@@ -26,70 +32,153 @@
 #include "fs.h"
 #include "buf.h"
 
+struct bucket {
+  struct spinlock lock;
+  struct buf *head;
+};
+
 struct {
   struct spinlock lock;
   struct buf buf[NBUF];
-
-  // Linked list of all buffers, through prev/next.
-  // head.next is most recently used.
-  struct buf head;
+  struct bucket bucket[NBUCKET];
 } bcache;
 
+static struct bucket*
+hash(uint dev, uint blockno)
+{
+  return &bcache.bucket[(dev * 31 + blockno) % NBUCKET];
+}
+
 void
 binit(void)
 {
   struct buf *b;
+  struct bucket *bk;
 
   initlock(&bcache.lock, "bcache");
+  for(bk = bcache.bucket; bk < bcache.bucket+NBUCKET; bk++)
+    initlock(&bk->lock, "bcache.bucket");
 
 //PAGEBREAK!
-  // Create linked list of buffers
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
+  // Spread the empty buffers over the buckets.
   for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
+    bk = &bcache.bucket[(b - bcache.buf) % NBUCKET];
+    b->next = bk->head;
+    bk->head = b;
     initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
   }
 }
 
+// Return the buffer for the block in bk, or 0.
+// Caller must hold bk->lock.
+static struct buf*
+lookup(struct bucket *bk, uint dev, uint blockno)
+{
+  struct buf *b;
+
+  for(b = bk->head; b; b = b->next)
+    if(b->dev == dev && b->blockno == blockno)
+      return b;
+  return 0;
+}
+
+// Find the unused buffer released longest ago, unlink it from
+// its bucket and return it, or 0 if every buffer is in use.
+// Caller must hold bcache.lock and bk->lock. The lock of the
+// bucket holding the best candidate so far stays held, so no
+// one can take the candidate while the rest are scanned.
+static struct buf*
+evict(struct bucket *bk)
+{
+  struct bucket *b2, *held;
+  struct buf *b, *best, **pp;
+  int found;
+
+  best = 0;
+  held = 0;
+  for(b2 = bcache.bucket; b2 < bcache.bucket+NBUCKET; b2++){
+    if(b2 != bk)
+      acquire(&b2->lock);
+    found = 0;
+    // Even if refcnt==0, B_DIRTY indicates a buffer is in use
+    // because log.c has modified it but not yet committed it.
+    for(b = b2->head; b; b = b->next){
+      if(b->refcnt == 0 && (b->flags & B_DIRTY) == 0 &&
+         (best == 0 || b->lastuse < best->lastuse)){
+        best = b;
+        found = 1;
+      }
+    }
+    if(found){
+      if(held && held != bk)
+        release(&held->lock);
+      held = b2;
+    } else if(b2 != bk)
+      release(&b2->lock);
+  }
+  if(best == 0)
+    return 0;
+
+  for(pp = &held->head; *pp != best; pp = &(*pp)->next)
+    ;
+  *pp = best->next;
+  if(held != bk)
+    release(&held->lock);
+  return best;
+}
+
+// Give an unused buffer to the block, which is not cached,
+// and return it with one reference, or 0 if every buffer is in
+// use. Caller must hold bcache.lock and bk->lock.
+static struct buf*
+recycle(struct bucket *bk, uint dev, uint blockno)
+{
+  struct buf *b;
+
+  if((b = evict(bk)) == 0)
+    return 0;
+  b->dev = dev;
+  b->blockno = blockno;
+  b->flags = 0;
+  b->refcnt = 1;
+  b->next = bk->head;
+  bk->head = b;
+  return b;
+}
+
 // Look through buffer cache for block on device dev.
 // If not found, allocate a buffer.
 // In either case, return locked buffer.
 static struct buf*
 bget(uint dev, uint blockno)
 {
+  struct bucket *bk;
   struct buf *b;
 
-  acquire(&bcache.lock);
+  bk = hash(dev, blockno);
 
   // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
-    if(b->dev == dev && b->blockno == blockno){
-      b->refcnt++;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
-    }
+  acquire(&bk->lock);
+  if((b = lookup(bk, dev, blockno)) != 0)
+    b->refcnt++;
+  release(&bk->lock);
+  if(b){
+    acquiresleep(&b->lock);
+    return b;
   }
 
-  // Not cached; recycle an unused buffer.
-  // Even if refcnt==0, B_DIRTY indicates a buffer is in use
-  // because log.c has modified it but not yet committed it.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0 && (b->flags & B_DIRTY) == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->flags = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
-    }
-  }
-  panic("bget: no buffers");
+  // Not cached; recycle an unused buffer. Look again once
+  // misses are serialized, in case another one cached it.
+  acquire(&bcache.lock);
+  acquire(&bk->lock);
+  if((b = lookup(bk, dev, blockno)) != 0)
+    b->refcnt++;
+  else if((b = recycle(bk, dev, blockno)) == 0)
+    panic("bget: no buffers");
+  release(&bk->lock);
+  release(&bcache.lock);
+  acquiresleep(&b->lock);
+  return b;
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -105,6 +194,57 @@ bread(uint dev, uint blockno)
   return b;
 }
 
+// Return a locked buf for the indicated block without reading
+// it from disk, for a caller that will overwrite all of it.
+struct buf*
+bnew(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget(dev, blockno);
+  b->flags |= B_VALID;
+  return b;
+}
+
+// Start reading a block into the cache without waiting for
+// it, unless it is cached already. The buffer stays locked
+// until the disk interrupt hands it to bdone().
+void
+breadahead(uint dev, uint blockno)
+{
+  struct bucket *bk;
+  struct buf *b;
+
+  bk = hash(dev, blockno);
+  acquire(&bk->lock);
+  b = lookup(bk, dev, blockno);
+  release(&bk->lock);
+  if(b)
+    return;
+
+  acquire(&bcache.lock);
+  acquire(&bk->lock);
+  if(lookup(bk, dev, blockno) != 0)
+    b = 0;
+  else
+    b = recycle(bk, dev, blockno);
+  release(&bk->lock);
+  release(&bcache.lock);
+  if(b == 0)
+    return;
+
+  // Once the locks are dropped a bread() of the same block can
+  // find the buffer and lock it first, so this may sleep, and
+  // the block may be valid (or dirty) by the time it returns.
+  acquiresleep(&b->lock);
+  if(b->flags & (B_VALID|B_DIRTY)){
+    brelse(b);
+    return;
+  }
+  b->flags |= B_ASYNC;
+  idereadahead(b);
+}
+
 // Write b's contents to disk.  Must be locked.
 void
 bwrite(struct buf *b)
@@ -115,29 +255,50 @@ bwrite(struct buf *b)
   iderw(b);
 }
 
+// Write the n locked buffers b[] to disk together, so the
+// disk driver can sort and merge the requests.
+void
+bwritev(struct buf **b, int n)
+{
+  int i;
+
+  for(i = 0; i < n; i++){
+    if(!holdingsleep(&b[i]->lock))
+      panic("bwritev");
+    b[i]->flags |= B_DIRTY;
+  }
+  iderwv(b, n);
+}
+
 // Release a locked buffer.
-// Move to the head of the MRU list.
 void
 brelse(struct buf *b)
 {
   if(!holdingsleep(&b->lock))
     panic("brelse");
 
+  bdone(b);
+}
+
+// Unlock b and drop a reference, on behalf of whoever locked
+// it; ideintr() finishes read-ahead with this. Stamp b for LRU
+// eviction when the last reference goes.
+void
+bdone(struct buf *b)
+{
+  struct bucket *bk;
+
   releasesleep(&b->lock);
 
-  acquire(&bcache.lock);
+  // refcnt > 0 keeps b in the same bucket until we're done.
+  bk = hash(b->dev, b->blockno);
+  acquire(&bk->lock);
   b->refcnt--;
   if (b->refcnt == 0) {
     // no one is waiting for it.
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+    b->lastuse = ticks;
   }
-  
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 //PAGEBREAK!
 // Blank page.
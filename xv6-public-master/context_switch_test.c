@@ -0,0 +1,61 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "bench.h"
+
+// pairs, round trips per pair
+int args[] = { 4, 2000 };
+
+// Bounce one byte between a parent and a child over two pipes.
+// Each round trip blocks both sides once, so it costs at least
+// two context switches.
+void ping_pong(int i)
+{
+    int rounds = args[1];
+    int to_child[2], to_parent[2];
+    char token = 'x';
+
+    if(pipe(to_child) < 0 || pipe(to_parent) < 0)
+    {
+        printf(2, "ERROR: pipe failed!\n");
+        exit();
+    }
+
+    int pid = fork();
+
+    if(pid < 0)
+    {
+        printf(2, "ERROR: fork failed!\n");
+        exit();
+    }
+
+    if(pid == 0)
+    {
+        for(int i = 0; i < rounds; i++)
+        {
+            if(read(to_child[0], &token, 1) != 1)
+                break;
+            write(to_parent[1], &token, 1);
+        }
+        exit();
+    }
+
+    for(int i = 0; i < rounds; i++)
+    {
+        write(to_child[1], &token, 1);
+        if(read(to_parent[0], &token, 1) != 1)
+            break;
+    }
+
+    wait();
+}
+
+int main(int argc, char *argv[])
+{
+    benchargs(argc, argv, args, 2, "context_switch_test [pairs] [rounds]");
+
+    int elapsed = runjobs(args[0], ping_pong);
+    printrate(args[0], "pairs", args[1], "round trips", elapsed);
+
+    exit();
+}
@@ -0,0 +1,67 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define HEAP_PAGES 256
+#define ROUNDS 100
+
+int main(int argc, char *argv[])
+{
+    // Child side of the fork+exec rounds.
+    if(argc > 1 && strcmp(argv[1], "exit") == 0)
+        exit();
+
+    // Give the parent a heap worth copying and touch every page.
+    char *heap = sbrk(HEAP_PAGES * 4096);
+    if(heap == (char*)-1)
+    {
+        printf(2, "ERROR: sbrk failed!\n");
+        exit();
+    }
+    for(int i = 0; i < HEAP_PAGES; i++)
+        heap[i * 4096] = i;
+
+    // Pages a fork costs before the child writes anything.
+    int fds[2], used;
+    pipe(fds);
+    int before = get_free_pages();
+    if(fork() == 0)
+    {
+        used = before - get_free_pages();
+        write(fds[1], &used, sizeof(used));
+        exit();
+    }
+    read(fds[0], &used, sizeof(used));
+    wait();
+    close(fds[0]);
+    close(fds[1]);
+
+    int start = uptime();
+    for(int i = 0; i < ROUNDS; i++)
+    {
+        if(fork() == 0)
+            exit();
+        wait();
+    }
+    int fork_ticks = uptime() - start;
+
+    char *args[] = { "cow_fork_test", "exit", 0 };
+    start = uptime();
+    for(int i = 0; i < ROUNDS; i++)
+    {
+        if(fork() == 0)
+        {
+            exec("cow_fork_test", args);
+            printf(2, "ERROR: exec failed!\n");
+            exit();
+        }
+        wait();
+    }
+    int exec_ticks = uptime() - start;
+
+    printf(1, "heap of %d pages: fork takes %d pages\n", HEAP_PAGES, used);
+    printf(1, "%d fork+exit in %d ticks, %d fork+exec in %d ticks\n",
+           ROUNDS, fork_ticks, ROUNDS, exec_ticks);
+
+    exit();
+}
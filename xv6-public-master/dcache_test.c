@@ -0,0 +1,88 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define DEPTH 8
+#define ROUNDS 1000
+
+char path[DEPTH * 3 + 8];
+
+int main(int argc, char *argv[])
+{
+    struct stat st;
+    int i, fd;
+
+    // Build d0/d1/.../d7/file.
+    for(i = 0; i < DEPTH; i++)
+    {
+        path[i * 3] = 'd';
+        path[i * 3 + 1] = '0' + i;
+        path[i * 3 + 2] = 0;
+        if(mkdir(path) < 0)
+        {
+            printf(2, "ERROR: cannot make %s!\n", path);
+            exit();
+        }
+        path[i * 3 + 2] = '/';
+    }
+    strcpy(path + DEPTH * 3, "file");
+    if((fd = open(path, O_CREATE | O_RDWR)) < 0)
+    {
+        printf(2, "ERROR: cannot create %s!\n", path);
+        exit();
+    }
+    close(fd);
+
+    int start = uptime();
+    for(i = 0; i < ROUNDS; i++)
+    {
+        if(stat(path, &st) < 0)
+        {
+            printf(2, "ERROR: cannot stat %s!\n", path);
+            exit();
+        }
+    }
+    printf(1, "%d lookups of a %d-deep path in %d ticks\n",
+           ROUNDS, DEPTH + 1, uptime() - start);
+
+    // Like sh trying a command that is not there.
+    char *args[] = { "nosuchcmd", 0 };
+    start = uptime();
+    for(i = 0; i < ROUNDS; i++)
+    {
+        if(exec("nosuchcmd", args) >= 0 || stat(path + 1, &st) >= 0)
+        {
+            printf(2, "ERROR: found a file that is not there!\n");
+            exit();
+        }
+    }
+    printf(1, "%d failed lookups in %d ticks\n", 2 * ROUNDS, uptime() - start);
+
+    // The cache must follow unlinks and re-creates.
+    unlink(path);
+    if(stat(path, &st) >= 0)
+    {
+        printf(2, "ERROR: %s still there after unlink!\n", path);
+        exit();
+    }
+    if((fd = open(path, O_CREATE | O_RDWR)) < 0 || stat(path, &st) < 0)
+    {
+        printf(2, "ERROR: cannot re-create %s!\n", path);
+        exit();
+    }
+    close(fd);
+    unlink(path);
+
+    for(i = DEPTH - 1; i >= 0; i--)
+    {
+        path[i * 3 + 2] = 0;
+        if(unlink(path) < 0)
+        {
+            printf(2, "ERROR: cannot unlink %s!\n", path);
+            exit();
+        }
+    }
+
+    exit();
+}
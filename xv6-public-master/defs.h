@@ -2,6 +2,7 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct lathist;
 struct pipe;
 struct proc;
 struct rtcdate;
@@ -10,12 +11,17 @@ struct sleeplock;
 struct stat;
 struct superblock;
 struct reentrantlock ;
+struct runqueue;
 
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
+struct buf*     bnew(uint, uint);
+void            breadahead(uint, uint);
 void            brelse(struct buf*);
+void            bdone(struct buf*);
 void            bwrite(struct buf*);
+void            bwritev(struct buf**, int);
 
 // console.c
 void            consoleinit(void);
@@ -39,8 +45,10 @@ int             filewrite(struct file*, char*, int n);
 void            readsb(int dev, struct superblock *sb);
 int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
+void            dirunlink(struct inode*, uint);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
+void            icachestats(uint*, uint*);
 void            iinit(int dev);
 void            ilock(struct inode*);
 void            iput(struct inode*);
@@ -51,6 +59,7 @@ int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, char*, uint, uint);
+uint            ireadahead(struct inode*, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, char*, uint, uint);
 
@@ -58,6 +67,8 @@ int             writei(struct inode*, char*, uint, uint);
 void            ideinit(void);
 void            ideintr(void);
 void            iderw(struct buf*);
+void            idereadahead(struct buf*);
+void            iderwv(struct buf**, int);
 
 // ioapic.c
 void            ioapicenable(int irq, int cpu);
@@ -67,6 +78,9 @@ void            ioapicinit(void);
 // kalloc.c
 char*           kalloc(void);
 void            kfree(char*);
+void            kincref(char*);
+int             krefcount(char*);
+int             kfreecount(void);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
 
@@ -87,6 +101,7 @@ void            initlog(int dev);
 void            log_write(struct buf*);
 void            begin_op();
 void            end_op();
+void            log_sync(void);
 
 // mp.c
 extern int      ismp;
@@ -118,6 +133,7 @@ void            sched(void);
 void            setproc(struct proc*);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
+void            kproc(char*, void (*)(void));
 int             wait(void);
 void            wakeup(void*);
 void            yield(void);
@@ -126,17 +142,23 @@ int             sort_syscalls(int);
 int             get_most_invoked_syscall(int);
 int             list_all_processes(void);
 struct proc*    get_proc_by_pid(int);
+int             get_total_syscalls(int);
 int             create_randoom_number(int);
-struct proc*    round_robin(struct proc*);
-struct proc*    shortest_job_first(void);
-struct proc*    first_come_first_service(void);
+void            rq_add(struct proc*);
+struct proc*    round_robin(struct runqueue*);
+struct proc*    shortest_job_first(struct runqueue*);
+struct proc*    first_come_first_service(struct runqueue*);
 void            aging(void);
+struct proc*    steal_process(int, int);
 void            run_process_on_cpu(struct proc*, struct cpu*);
 int             set_initial_burst_confidence(int, int, int );
 int             change_queue(int, int);
 int             print_process_information(void);
 int             get_number_of_total_syscalls(void);
 int             reentrantlock_test(int);
+int             get_steal_count(int);
+int             get_proc_latency(int, struct lathist*);
+int             getprocstats(uint, int);
 void            rinit(void);
 void            initreentrantlock(char*);
 void            acquirereentrantlock(void);
@@ -145,6 +167,14 @@ void            releasereentrantlock(void);
 // swtch.S
 void            swtch(struct context**, struct context*);
 
+// sharedmem.c
+void            init_sharedmem(void);
+char*           open_sharedmem(int, int);
+int             close_sharedmem(int);
+int             fork_sharedmem(struct proc*, struct proc*);
+void            exit_sharedmem(struct proc*);
+int             in_sharedmem(struct proc*, uint, uint);
+
 // spinlock.c
 void            acquire(struct spinlock*);
 void            getcallerpcs(void*, uint*);
@@ -172,18 +202,25 @@ char*           strncpy(char*, const char*, int);
 // syscall.c
 int             argint(int, int*);
 int             argptr(int, char**, int);
+int             argptrw(int, char**, int);
 int             argstr(int, char**);
 int             fetchint(uint, int*);
 int             fetchstr(uint, char**);
 void            syscall(void);
+void            get_system_latency(struct lathist*);
 
 // timer.c
 void            timerinit(void);
 
+// trace.c
+void            traceinit(void);
+void            trace(int, int, int);
+int             trace_read(uint, int);
+
 // trap.c
 void            idtinit(void);
 extern uint     ticks;
-extern uint     total_number_of_syscalls;
+int             get_cpu_syscalls(int);
 void            tvinit(void);
 extern struct spinlock tickslock;
 
@@ -203,6 +240,13 @@ void            freevm(pde_t*);
 void            inituvm(pde_t*, char*, uint);
 int             loaduvm(pde_t*, char*, struct inode*, uint, uint);
 pde_t*          copyuvm(pde_t*, uint);
+int             cowfault(pde_t*, uint);
+int             uvmfault(struct proc*, uint, uint);
+int             uvmpagein(struct proc*, uint, uint, int);
+int             mapshared(pde_t*, uint, char**, int);
+void            unmapshared(pde_t*, uint, int);
+char*           lendpage(pde_t*, uint);
+int             swappage(pde_t*, uint, char**);
 void            switchuvm(struct proc*);
 void            switchkvm(void);
 int             copyout(pde_t*, uint, void*, uint);
@@ -0,0 +1,54 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define ROUNDS 50
+
+// Fork and exec argv ROUNDS times with output discarded,
+// returning the ticks taken.
+int run(char **argv)
+{
+    int start = uptime();
+
+    for(int i = 0; i < ROUNDS; i++)
+    {
+        int pid = fork();
+
+        if(pid < 0)
+        {
+            printf(2, "ERROR: fork failed!\n");
+            exit();
+        }
+
+        if(pid == 0)
+        {
+            close(1);
+            close(2);
+            open("demand_exec_out", O_CREATE | O_WRONLY);
+            dup(1);
+            exec(argv[0], argv);
+            exit();
+        }
+
+        wait();
+    }
+
+    return uptime() - start;
+}
+
+int main(int argc, char *argv[])
+{
+    char *ls[] = { "ls", 0 };
+    char *echo[] = { "echo", "hello", 0 };
+    char *grep[] = { "grep", "xv6", "README", 0 };
+
+    printf(1, "%d runs each:\n", ROUNDS);
+    printf(1, "ls: %d ticks\n", run(ls));
+    printf(1, "echo: %d ticks\n", run(echo));
+    printf(1, "grep: %d ticks\n", run(grep));
+
+    unlink("demand_exec_out");
+
+    exit();
+}
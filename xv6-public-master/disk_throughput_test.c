@@ -0,0 +1,86 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fs.h"
+#include "fcntl.h"
+
+#define PASSES 2
+#define WRITE_BLOCKS 120
+
+char buf[8 * BSIZE];
+
+// Print bytes over ticks (10ms each) as KB/s.
+void report(char *label, int bytes, int ticks)
+{
+    if(ticks == 0)
+        ticks = 1;
+
+    printf(1, "%s: %d KB in %d ticks, %d KB/s\n",
+           label, bytes / 1024, ticks, bytes / 1024 * 100 / ticks);
+}
+
+// Read every file in the root directory. Together they are
+// larger than the buffer cache, so each pass goes to the disk.
+int read_all(void)
+{
+    struct dirent de;
+    char name[DIRSIZ + 2];
+    int total = 0, n;
+
+    int dir = open("/", O_RDONLY);
+    if(dir < 0)
+    {
+        printf(2, "ERROR: cannot open /!\n");
+        exit();
+    }
+
+    while(read(dir, &de, sizeof(de)) == sizeof(de))
+    {
+        if(de.inum == 0)
+            continue;
+
+        name[0] = '/';
+        memmove(name + 1, de.name, DIRSIZ);
+        name[DIRSIZ + 1] = 0;
+
+        struct stat st;
+        if(stat(name, &st) < 0 || st.type != T_FILE)
+            continue;
+
+        int fd = open(name, O_RDONLY);
+        while((n = read(fd, buf, sizeof(buf))) > 0)
+            total += n;
+        close(fd);
+    }
+
+    close(dir);
+    return total;
+}
+
+int main(int argc, char *argv[])
+{
+    for(int p = 0; p < PASSES; p++)
+    {
+        int start = uptime();
+        int bytes = read_all();
+
+        report("sequential read of /", bytes, uptime() - start);
+    }
+
+    int fd = open("disk_throughput_tmp", O_CREATE | O_RDWR);
+    if(fd < 0)
+    {
+        printf(2, "ERROR: cannot create file!\n");
+        exit();
+    }
+
+    int start = uptime();
+    for(int i = 0; i < WRITE_BLOCKS; i++)
+        write(fd, buf, BSIZE);
+    close(fd);
+    report("sequential write", WRITE_BLOCKS * BSIZE, uptime() - start);
+
+    unlink("disk_throughput_tmp");
+
+    exit();
+}
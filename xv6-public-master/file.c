@@ -96,7 +96,7 @@ filestat(struct file *f, struct stat *st)
 int
 fileread(struct file *f, char *addr, int n)
 {
-  int r;
+  int r, seq;
 
   if(f->readable == 0)
     return -1;
@@ -104,8 +104,17 @@ fileread(struct file *f, char *addr, int n)
     return piperead(f->pipe, addr, n);
   if(f->type == FD_INODE){
     ilock(f->ip);
+    seq = f->off == f->rdend;
     if((r = readi(f->ip, addr, f->off, n)) > 0)
       f->off += r;
+    // Keep the next NREADAHEAD blocks of a sequential reader
+    // on their way from the disk.
+    if(seq && r > 0){
+      if(f->ranext < f->off / BSIZE)
+        f->ranext = f->off / BSIZE;
+      f->ranext = ireadahead(f->ip, f->ranext, f->off / BSIZE + NREADAHEAD);
+    }
+    f->rdend = f->off;
     iunlock(f->ip);
     return r;
   }
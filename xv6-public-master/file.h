@@ -6,6 +6,8 @@ struct file {
   struct pipe *pipe;
   struct inode *ip;
   uint off;
+  uint rdend;  // where the last read ended, to spot sequential reads
+  uint ranext; // first block not yet read ahead
 };
 
 
@@ -14,6 +16,8 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct inode *next; // hash bucket chain
+  uint lastuse;       // ticks when ref last dropped to 0
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -22,7 +26,8 @@ struct inode {
   short minor;
   short nlink;
   uint size;
-  uint addrs[NDIRECT+1];
+  uint addrs[NDIRECT+2];
+  uint nextblock;     // where bmap() looks first for a new block
 };
 
 // table mapping major device number to
@@ -44,7 +44,7 @@ bzero(int dev, int bno)
 {
   struct buf *bp;
 
-  bp = bread(dev, bno);
+  bp = bnew(dev, bno);
   memset(bp->data, 0, BSIZE);
   log_write(bp);
   brelse(bp);
@@ -52,46 +52,163 @@ bzero(int dev, int bno)
 
 // Blocks.
 
-// Allocate a zeroed disk block.
+// Allocation summaries, for the one device we run with: how
+// many blocks are free in the part of the disk each bitmap
+// block describes, and how many inodes are free in each inode
+// block, or -1 until that block has been read. A block known
+// to have nothing free is skipped without being read. The
+// counts only change while the bitmap or inode block they
+// describe is locked, except that freeing an inode just marks
+// its block's count unknown. bnext and inext are next-fit
+// cursors: where balloc() starts when it has no goal, and
+// where ialloc() starts.
+struct {
+  struct spinlock lock;
+  int nbfree[FSSIZE/BPB + 1];
+  int nifree[NINODES/IPB + 1];
+  uint bnext;
+  uint inext;
+} fsalloc;
+
+static void
+fsalloc_init(void)
+{
+  int i;
+
+  if(sb.size > FSSIZE || sb.ninodes > NINODES)
+    panic("fsalloc_init: file system too big");
+  initlock(&fsalloc.lock, "fsalloc");
+  for(i = 0; i < NELEM(fsalloc.nbfree); i++)
+    fsalloc.nbfree[i] = -1;
+  for(i = 0; i < NELEM(fsalloc.nifree); i++)
+    fsalloc.nifree[i] = -1;
+  fsalloc.inext = 1;
+}
+
+// Return the first clear bit of map in [lo, hi), or -1,
+// skipping whole words that are all ones.
+static int
+bitscan(uchar *map, uint lo, uint hi)
+{
+  uint bi;
+
+  for(bi = lo; bi < hi; ){
+    if(bi % 32 == 0 && bi + 32 <= hi && ((uint*)map)[bi/32] == ~0U){
+      bi += 32;
+      continue;
+    }
+    if((map[bi/8] & (1 << (bi % 8))) == 0)
+      return bi;
+    bi++;
+  }
+  return -1;
+}
+
+// Free blocks described by bitmap block bp, which starts at
+// block b.
+static int
+bcount(struct buf *bp, uint b)
+{
+  uint bi, n;
+
+  n = 0;
+  for(bi = 0; bi < BPB && b + bi < sb.size; bi++)
+    if((bp->data[bi/8] & (1 << (bi % 8))) == 0)
+      n++;
+  return n;
+}
+
+// Allocate a disk block: the first free one at or after goal,
+// else the first free one before it. Without a goal, start
+// where the last allocation left off. Zero it unless the
+// caller is about to overwrite all of it anyway.
 static uint
-balloc(uint dev)
+balloc(uint dev, uint goal, int zero)
 {
-  int b, bi, m;
+  int pass, bi, n;
+  uint b, start, end;
   struct buf *bp;
 
-  bp = 0;
-  for(b = 0; b < sb.size; b += BPB){
-    bp = bread(dev, BBLOCK(b, sb));
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
-        bp->data[bi/8] |= m;  // Mark block in use.
+  if(goal == 0 || goal >= sb.size)
+    goal = fsalloc.bnext;
+  if(goal >= sb.size)
+    goal = 0;
+  for(pass = 0; pass < 2; pass++){
+    start = pass == 0 ? goal : 0;
+    end = pass == 0 ? sb.size : goal;
+    for(b = start - start % BPB; b < end; b += BPB){
+      acquire(&fsalloc.lock);
+      n = fsalloc.nbfree[b/BPB];
+      release(&fsalloc.lock);
+      if(n == 0)
+        continue;
+      bp = bread(dev, BBLOCK(b, sb));
+      acquire(&fsalloc.lock);
+      if((n = fsalloc.nbfree[b/BPB]) < 0)
+        n = bcount(bp, b);
+      bi = bitscan(bp->data, b < start ? start - b : 0, min(BPB, end - b));
+      if(bi >= 0){
+        n--;
+        fsalloc.bnext = b + bi + 1;
+      }
+      fsalloc.nbfree[b/BPB] = n;
+      release(&fsalloc.lock);
+      if(bi >= 0){
+        bp->data[bi/8] |= 1 << (bi % 8);  // Mark block in use.
         log_write(bp);
         brelse(bp);
-        bzero(dev, b + bi);
+        if(zero)
+          bzero(dev, b + bi);
         return b + bi;
       }
+      brelse(bp);
     }
-    brelse(bp);
   }
   panic("balloc: out of blocks");
 }
 
+// Free the non-zero block numbers among a[0..n-1], reading
+// and logging each bitmap block once for a run of blocks it
+// describes, as those of a file mostly are.
+static void
+bfreen(int dev, uint *a, int n)
+{
+  struct buf *bp;
+  int i, bi, m, nfreed;
+
+  bp = 0;
+  nfreed = 0;
+  for(i = 0; i <= n; i++){
+    if(i < n && a[i] == 0)
+      continue;
+    if(bp && (i == n || BBLOCK(a[i], sb) != bp->blockno)){
+      acquire(&fsalloc.lock);
+      if(fsalloc.nbfree[bp->blockno - sb.bmapstart] >= 0)
+        fsalloc.nbfree[bp->blockno - sb.bmapstart] += nfreed;
+      release(&fsalloc.lock);
+      log_write(bp);
+      brelse(bp);
+      bp = 0;
+      nfreed = 0;
+    }
+    if(i == n)
+      break;
+    if(bp == 0)
+      bp = bread(dev, BBLOCK(a[i], sb));
+    bi = a[i] % BPB;
+    m = 1 << (bi % 8);
+    if((bp->data[bi/8] & m) == 0)
+      panic("freeing free block");
+    bp->data[bi/8] &= ~m;
+    nfreed++;
+  }
+}
+
 // Free a disk block.
 static void
 bfree(int dev, uint b)
 {
-  struct buf *bp;
-  int bi, m;
-
-  bp = bread(dev, BBLOCK(b, sb));
-  bi = b % BPB;
-  m = 1 << (bi % 8);
-  if((bp->data[bi/8] & m) == 0)
-    panic("freeing free block");
-  bp->data[bi/8] &= ~m;
-  log_write(bp);
-  brelse(bp);
+  bfreen(dev, &b, 1);
 }
 
 // Inodes.
@@ -154,31 +271,63 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
-// The icache.lock spin-lock protects the allocation of icache
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold icache.lock while using any of those fields.
+// The icache is a hash table keyed by (dev, inum). An entry
+// whose ref has fallen to zero stays in its bucket, still valid,
+// until a miss recycles it, oldest first, so a later iget() of
+// the same inode need not read it from disk again.
+//
+// Each bucket's spin-lock protects the ref, dev, inum and chain
+// fields of the entries in it. icache.lock serializes misses,
+// like bcache.lock, so two of them can't cache the same inode
+// twice; the lock order is icache.lock, then bucket locks.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
-// dev, and inum.  One must hold ip->lock in order to
+// dev, inum, next and lastuse.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
+struct ibucket {
+  struct spinlock lock;
+  struct inode *head;
+  uint hits;          // iget() calls that found the inode cached
+  uint misses;        // iget() calls that had to recycle an entry
+};
+
 struct {
   struct spinlock lock;
   struct inode inode[NINODE];
+  struct ibucket bucket[NIBUCKET];
 } icache;
 
+static struct ibucket*
+ihash(uint dev, uint inum)
+{
+  return &icache.bucket[(dev * 31 + inum) % NIBUCKET];
+}
+
+static void dirindex_init(void);
+static void dcache_init(void);
+
 void
 iinit(int dev)
 {
-  int i = 0;
-  
+  struct inode *ip;
+  struct ibucket *bk;
+
   initlock(&icache.lock, "icache");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&icache.inode[i].lock, "inode");
+  dirindex_init();
+  dcache_init();
+  for(bk = icache.bucket; bk < icache.bucket+NIBUCKET; bk++)
+    initlock(&bk->lock, "icache.bucket");
+  // Empty entries have inum 0, which no iget() asks for.
+  for(ip = icache.inode; ip < icache.inode+NINODE; ip++){
+    bk = &icache.bucket[(ip - icache.inode) % NIBUCKET];
+    ip->next = bk->head;
+    bk->head = ip;
+    initsleeplock(&ip->lock, "inode");
   }
 
   readsb(dev, &sb);
+  fsalloc_init();
   cprintf("sb: size %d nblocks %d ninodes %d nlog %d logstart %d\
  inodestart %d bmap start %d\n", sb.size, sb.nblocks,
           sb.ninodes, sb.nlog, sb.logstart, sb.inodestart,
@@ -186,6 +335,8 @@ iinit(int dev)
 }
 
 static struct inode* iget(uint dev, uint inum);
+static void dirindex_drop(uint dev, uint inum);
+static void dcache_purge(uint dev, uint dir);
 
 //PAGEBREAK!
 // Allocate an inode on device dev.
@@ -194,19 +345,43 @@ static struct inode* iget(uint dev, uint inum);
 struct inode*
 ialloc(uint dev, short type)
 {
-  int inum;
+  int n, found;
+  uint i, blk, nblk, inum;
   struct buf *bp;
   struct dinode *dip;
 
-  for(inum = 1; inum < sb.ninodes; inum++){
-    bp = bread(dev, IBLOCK(inum, sb));
-    dip = (struct dinode*)bp->data + inum%IPB;
-    if(dip->type == 0){  // a free inode
+  nblk = sb.ninodes / IPB + 1;
+  for(i = 0; i < nblk; i++){
+    blk = (fsalloc.inext / IPB + i) % nblk;
+    acquire(&fsalloc.lock);
+    n = fsalloc.nifree[blk];
+    release(&fsalloc.lock);
+    if(n == 0)
+      continue;
+    bp = bread(dev, sb.inodestart + blk);
+    n = 0;
+    found = 0;
+    for(inum = blk * IPB; inum < (blk + 1) * IPB && inum < sb.ninodes; inum++){
+      dip = (struct dinode*)bp->data + inum%IPB;
+      if(inum == 0 || dip->type != 0)
+        continue;
+      if(found == 0)
+        found = inum;
+      else
+        n++;
+    }
+    acquire(&fsalloc.lock);
+    fsalloc.nifree[blk] = n;
+    if(found)
+      fsalloc.inext = found + 1;
+    release(&fsalloc.lock);
+    if(found){  // a free inode
+      dip = (struct dinode*)bp->data + found%IPB;
       memset(dip, 0, sizeof(*dip));
       dip->type = type;
       log_write(bp);   // mark it allocated on the disk
       brelse(bp);
-      return iget(dev, inum);
+      return iget(dev, found);
     }
     brelse(bp);
   }
@@ -235,37 +410,100 @@ iupdate(struct inode *ip)
   brelse(bp);
 }
 
+// Return the cached entry for the inode in bk, or 0.
+// Caller must hold bk->lock.
+static struct inode*
+ilookup(struct ibucket *bk, uint dev, uint inum)
+{
+  struct inode *ip;
+
+  for(ip = bk->head; ip; ip = ip->next)
+    if(ip->dev == dev && ip->inum == inum)
+      return ip;
+  return 0;
+}
+
+// Find the unreferenced entry released longest ago, unlink it
+// from its bucket and return it, or 0 if every entry is in use.
+// Caller must hold icache.lock and bk->lock. As in the buffer
+// cache, the bucket of the best candidate so far stays locked.
+static struct inode*
+ievict(struct ibucket *bk)
+{
+  struct ibucket *b2, *held;
+  struct inode *ip, *best, **pp;
+  int found;
+
+  best = 0;
+  held = 0;
+  for(b2 = icache.bucket; b2 < icache.bucket+NIBUCKET; b2++){
+    if(b2 != bk)
+      acquire(&b2->lock);
+    found = 0;
+    for(ip = b2->head; ip; ip = ip->next){
+      if(ip->ref == 0 && (best == 0 || ip->lastuse < best->lastuse)){
+        best = ip;
+        found = 1;
+      }
+    }
+    if(found){
+      if(held && held != bk)
+        release(&held->lock);
+      held = b2;
+    } else if(b2 != bk)
+      release(&b2->lock);
+  }
+  if(best == 0)
+    return 0;
+
+  for(pp = &held->head; *pp != best; pp = &(*pp)->next)
+    ;
+  *pp = best->next;
+  if(held != bk)
+    release(&held->lock);
+  return best;
+}
+
 // Find the inode with number inum on device dev
 // and return the in-memory copy. Does not lock
 // the inode and does not read it from disk.
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct ibucket *bk;
+  struct inode *ip;
 
-  acquire(&icache.lock);
+  bk = ihash(dev, inum);
 
   // Is the inode already cached?
-  empty = 0;
-  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
-      release(&icache.lock);
-      return ip;
-    }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
+  acquire(&bk->lock);
+  if((ip = ilookup(bk, dev, inum)) != 0){
+    ip->ref++;
+    bk->hits++;
   }
+  release(&bk->lock);
+  if(ip)
+    return ip;
 
-  // Recycle an inode cache entry.
-  if(empty == 0)
-    panic("iget: no inodes");
-
-  ip = empty;
-  ip->dev = dev;
-  ip->inum = inum;
-  ip->ref = 1;
-  ip->valid = 0;
+  // Recycle an inode cache entry. Look again once misses
+  // are serialized, in case another one cached it.
+  acquire(&icache.lock);
+  acquire(&bk->lock);
+  if((ip = ilookup(bk, dev, inum)) != 0){
+    ip->ref++;
+    bk->hits++;
+  } else {
+    if((ip = ievict(bk)) == 0)
+      panic("iget: no inodes");
+    ip->dev = dev;
+    ip->inum = inum;
+    ip->ref = 1;
+    ip->valid = 0;
+    ip->next = bk->head;
+    bk->head = ip;
+    bk->misses++;
+  }
+  release(&bk->lock);
   release(&icache.lock);
 
   return ip;
@@ -276,12 +514,31 @@ iget(uint dev, uint inum)
 struct inode*
 idup(struct inode *ip)
 {
-  acquire(&icache.lock);
+  struct ibucket *bk;
+
+  bk = ihash(ip->dev, ip->inum);
+  acquire(&bk->lock);
   ip->ref++;
-  release(&icache.lock);
+  release(&bk->lock);
   return ip;
 }
 
+// Report how many iget() calls found their inode cached
+// and how many had to recycle an entry.
+void
+icachestats(uint *hits, uint *misses)
+{
+  struct ibucket *bk;
+
+  *hits = *misses = 0;
+  for(bk = icache.bucket; bk < icache.bucket+NIBUCKET; bk++){
+    acquire(&bk->lock);
+    *hits += bk->hits;
+    *misses += bk->misses;
+    release(&bk->lock);
+  }
+}
+
 // Lock the given inode.
 // Reads the inode from disk if necessary.
 void
@@ -305,6 +562,7 @@ ilock(struct inode *ip)
     ip->size = dip->size;
     memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
     brelse(bp);
+    ip->nextblock = 0;
     ip->valid = 1;
     if(ip->type == 0)
       panic("ilock: no type");
@@ -323,7 +581,7 @@ iunlock(struct inode *ip)
 
 // Drop a reference to an in-memory inode.
 // If that was the last reference, the inode cache entry can
-// be recycled.
+// be recycled, but stays cached until it is.
 // If that was the last reference and the inode has no links
 // to it, free the inode (and its content) on disk.
 // All calls to iput() must be inside a transaction in
@@ -331,24 +589,35 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
+  struct ibucket *bk;
+
+  bk = ihash(ip->dev, ip->inum);
   acquiresleep(&ip->lock);
   if(ip->valid && ip->nlink == 0){
-    acquire(&icache.lock);
+    acquire(&bk->lock);
     int r = ip->ref;
-    release(&icache.lock);
+    release(&bk->lock);
     if(r == 1){
       // inode has no links and no other references: truncate and free.
+      if(ip->type == T_DIR){
+        dirindex_drop(ip->dev, ip->inum);
+        dcache_purge(ip->dev, ip->inum);
+      }
       itrunc(ip);
       ip->type = 0;
       iupdate(ip);
+      acquire(&fsalloc.lock);
+      fsalloc.nifree[ip->inum / IPB] = -1;
+      release(&fsalloc.lock);
       ip->valid = 0;
     }
   }
   releasesleep(&ip->lock);
 
-  acquire(&icache.lock);
-  ip->ref--;
-  release(&icache.lock);
+  acquire(&bk->lock);
+  if(--ip->ref == 0)
+    ip->lastuse = ticks;
+  release(&bk->lock);
 }
 
 // Common idiom: unlock, then put.
@@ -367,17 +636,49 @@ iunlockput(struct inode *ip)
 // are listed in ip->addrs[].  The next NINDIRECT blocks are
 // listed in block ip->addrs[NDIRECT].
 
-// Return the disk block address of the nth block in inode ip.
-// If there is no such block, bmap allocates one.
+// Allocate a block for ip, right after the last one bmap()
+// gave it if that is free, so that a file written
+// sequentially gets a contiguous run of blocks.
 static uint
-bmap(struct inode *ip, uint bn)
+ballocnext(struct inode *ip, int zero)
 {
-  uint addr, *a;
+  uint addr;
+
+  addr = balloc(ip->dev, ip->nextblock, zero);
+  ip->nextblock = addr + 1;
+  return addr;
+}
+
+// Return entry i of indirect block addr, allocating the
+// block it names if necessary, zeroed if zero is set.
+static uint
+indirect(struct inode *ip, uint addr, uint i, int zero)
+{
+  uint *a;
   struct buf *bp;
 
+  bp = bread(ip->dev, addr);
+  a = (uint*)bp->data;
+  if((addr = a[i]) == 0){
+    a[i] = addr = ballocnext(ip, zero);
+    log_write(bp);
+  }
+  brelse(bp);
+  return addr;
+}
+
+// Return the disk block address of the nth block in inode ip.
+// If there is no such block, bmapw allocates one, zeroed
+// unless the caller is going to overwrite all of it. Indirect
+// blocks it allocates are always zeroed.
+static uint
+bmapw(struct inode *ip, uint bn, int zero)
+{
+  uint addr;
+
   if(bn < NDIRECT){
     if((addr = ip->addrs[bn]) == 0)
-      ip->addrs[bn] = addr = balloc(ip->dev);
+      ip->addrs[bn] = addr = ballocnext(ip, zero);
     return addr;
   }
   bn -= NDIRECT;
@@ -385,20 +686,51 @@ bmap(struct inode *ip, uint bn)
   if(bn < NINDIRECT){
     // Load indirect block, allocating if necessary.
     if((addr = ip->addrs[NDIRECT]) == 0)
-      ip->addrs[NDIRECT] = addr = balloc(ip->dev);
-    bp = bread(ip->dev, addr);
-    a = (uint*)bp->data;
-    if((addr = a[bn]) == 0){
-      a[bn] = addr = balloc(ip->dev);
-      log_write(bp);
-    }
-    brelse(bp);
-    return addr;
+      ip->addrs[NDIRECT] = addr = ballocnext(ip, 1);
+    return indirect(ip, addr, bn, zero);
+  }
+  bn -= NINDIRECT;
+
+  if(bn < NDINDIRECT){
+    // Load the doubly-indirect block, then the indirect
+    // block it points to, allocating as necessary.
+    if((addr = ip->addrs[NDIRECT+1]) == 0)
+      ip->addrs[NDIRECT+1] = addr = ballocnext(ip, 1);
+    addr = indirect(ip, addr, bn / NINDIRECT, 1);
+    return indirect(ip, addr, bn % NINDIRECT, zero);
   }
 
   panic("bmap: out of range");
 }
 
+// bmapw() for callers that keep what is already in the block.
+static uint
+bmap(struct inode *ip, uint bn)
+{
+  return bmapw(ip, bn, 1);
+}
+
+// Free indirect block addr and the blocks it points to,
+// which are themselves indirect blocks if depth > 1.
+static void
+bfreeindirect(uint dev, uint addr, int depth)
+{
+  int j;
+  struct buf *bp;
+  uint *a;
+
+  bp = bread(dev, addr);
+  a = (uint*)bp->data;
+  if(depth > 1){
+    for(j = 0; j < NINDIRECT; j++)
+      if(a[j])
+        bfreeindirect(dev, a[j], depth - 1);
+  } else
+    bfreen(dev, a, NINDIRECT);
+  brelse(bp);
+  bfree(dev, addr);
+}
+
 // Truncate inode (discard contents).
 // Only called when the inode has no links
 // to it (no directory entries referring to it)
@@ -407,28 +739,19 @@ bmap(struct inode *ip, uint bn)
 static void
 itrunc(struct inode *ip)
 {
-  int i, j;
-  struct buf *bp;
-  uint *a;
+  int i;
 
-  for(i = 0; i < NDIRECT; i++){
-    if(ip->addrs[i]){
-      bfree(ip->dev, ip->addrs[i]);
-      ip->addrs[i] = 0;
-    }
-  }
+  bfreen(ip->dev, ip->addrs, NDIRECT);
+  for(i = 0; i < NDIRECT; i++)
+    ip->addrs[i] = 0;
 
-  if(ip->addrs[NDIRECT]){
-    bp = bread(ip->dev, ip->addrs[NDIRECT]);
-    a = (uint*)bp->data;
-    for(j = 0; j < NINDIRECT; j++){
-      if(a[j])
-        bfree(ip->dev, a[j]);
+  for(i = 0; i < 2; i++){
+    if(ip->addrs[NDIRECT+i]){
+      bfreeindirect(ip->dev, ip->addrs[NDIRECT+i], i + 1);
+      ip->addrs[NDIRECT+i] = 0;
     }
-    brelse(bp);
-    bfree(ip->dev, ip->addrs[NDIRECT]);
-    ip->addrs[NDIRECT] = 0;
   }
+  ip->nextblock = 0;
 
   ip->size = 0;
   iupdate(ip);
@@ -475,6 +798,22 @@ readi(struct inode *ip, char *dst, uint off, uint n)
   return n;
 }
 
+// Start reading blocks [from, to) of ip into the buffer
+// cache without waiting, stopping at the end of the file.
+// Returns the first block not read ahead.
+// Caller must hold ip->lock.
+uint
+ireadahead(struct inode *ip, uint from, uint to)
+{
+  uint bn;
+
+  if(ip->type == T_DEV)
+    return from;
+  for(bn = from; bn < to && bn * BSIZE < ip->size; bn++)
+    breadahead(ip->dev, bmap(ip, bn));
+  return bn;
+}
+
 // PAGEBREAK!
 // Write data to inode.
 // Caller must hold ip->lock.
@@ -496,8 +835,12 @@ writei(struct inode *ip, char *src, uint off, uint n)
     return -1;
 
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
     m = min(n - tot, BSIZE - off%BSIZE);
+    // A block written whole needs neither zeroing nor reading.
+    if(m == BSIZE)
+      bp = bnew(ip->dev, bmapw(ip, off/BSIZE, 0));
+    else
+      bp = bread(ip->dev, bmap(ip, off/BSIZE));
     memmove(bp->data + off%BSIZE, src, m);
     log_write(bp);
     brelse(bp);
@@ -519,41 +862,385 @@ namecmp(const char *s, const char *t)
   return strncmp(s, t, DIRSIZ);
 }
 
+// Large directories get an in-memory hash index, so that
+// looking up or adding a name reads one or two dirents instead
+// of every block of the directory. A slot holds 1 + the number
+// of a dirent that had a name hashing there when it was added.
+// Unlinking leaves the slot stale rather than removing it, so
+// every candidate is checked against the dirent itself, and a
+// probe ends only at an empty slot. When stale slots fill the
+// table it is rebuilt from the directory.
+//
+// The contents of an index are protected by the sleep-lock of
+// its directory, which callers of dirlookup(), dirlink() and
+// dirunlink() hold. dindex.lock protects which directory each
+// index belongs to; busy keeps an index from being given to
+// another directory while its own is using it.
+
+struct dirindex {
+  uint dev;
+  uint inum;          // directory indexed, 0 if unused
+  int busy;
+  uint lastuse;       // ticks when last used
+  uint nused;         // non-empty slots, stale ones included
+  uint freeoff;       // no free dirent before this offset
+  ushort slot[DIRINDEXSLOTS];
+};
+
+struct {
+  struct spinlock lock;
+  struct dirindex index[NDIRINDEX];
+} dindex;
+
+static void
+dirindex_init(void)
+{
+  initlock(&dindex.lock, "dindex");
+}
+
+static uint
+dirhash(char *name)
+{
+  uint h;
+  int i;
+
+  h = 0;
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = h * 31 + (uchar)name[i];
+  return h % DIRINDEXSLOTS;
+}
+
+static void
+dirindex_insert(struct dirindex *x, char *name, uint off)
+{
+  uint h;
+
+  for(h = dirhash(name); x->slot[h]; h = (h + 1) % DIRINDEXSLOTS)
+    ;
+  x->slot[h] = off / sizeof(struct dirent) + 1;
+  x->nused++;
+}
+
+// Fill x from the dirents of dp. Returns -1 if dp has
+// too many entries to index.
+static int
+dirindex_build(struct inode *dp, struct dirindex *x)
+{
+  uint off, n;
+  struct buf *bp;
+  struct dirent *de;
+
+  memset(x->slot, 0, sizeof(x->slot));
+  x->nused = 0;
+  x->freeoff = dp->size;
+  for(off = 0; off < dp->size; off += BSIZE){
+    bp = bread(dp->dev, bmap(dp, off / BSIZE));
+    n = dp->size - off < BSIZE ? dp->size - off : BSIZE;
+    for(de = (struct dirent*)bp->data; (uchar*)de < bp->data + n; de++){
+      if(de->inum == 0){
+        if(x->freeoff == dp->size)
+          x->freeoff = off + ((uchar*)de - bp->data);
+      } else if(x->nused < DIRINDEXSLOTS / 2){
+        dirindex_insert(x, de->name, off + ((uchar*)de - bp->data));
+      } else {
+        brelse(bp);
+        return -1;
+      }
+    }
+    brelse(bp);
+  }
+  return 0;
+}
+
+// Return dp's index, building it if dp is large enough to
+// deserve one, or 0. Caller must hold dp->lock, and must
+// give the index back with dirindex_put().
+static struct dirindex*
+dirindex_get(struct inode *dp)
+{
+  struct dirindex *x, *victim;
+
+  if(dp->size < DIRINDEXMIN || dp->size > DIRINDEXSLOTS * sizeof(struct dirent))
+    return 0;
+
+  acquire(&dindex.lock);
+  victim = 0;
+  for(x = dindex.index; x < &dindex.index[NDIRINDEX]; x++){
+    if(x->inum == dp->inum && x->dev == dp->dev){
+      x->busy = 1;
+      release(&dindex.lock);
+      return x;
+    }
+    if(!x->busy && (victim == 0 || x->lastuse < victim->lastuse))
+      victim = x;
+  }
+  if(victim == 0){
+    release(&dindex.lock);
+    return 0;
+  }
+  x = victim;
+  x->dev = dp->dev;
+  x->inum = dp->inum;
+  x->busy = 1;
+  release(&dindex.lock);
+
+  if(dirindex_build(dp, x) < 0){
+    acquire(&dindex.lock);
+    x->inum = 0;
+    x->busy = 0;
+    release(&dindex.lock);
+    return 0;
+  }
+  return x;
+}
+
+static void
+dirindex_put(struct dirindex *x)
+{
+  acquire(&dindex.lock);
+  x->busy = 0;
+  x->lastuse = ticks;
+  release(&dindex.lock);
+}
+
+// Forget the index of directory inum, which is being freed.
+static void
+dirindex_drop(uint dev, uint inum)
+{
+  struct dirindex *x;
+
+  acquire(&dindex.lock);
+  for(x = dindex.index; x < &dindex.index[NDIRINDEX]; x++)
+    if(x->inum == inum && x->dev == dev)
+      x->inum = 0;
+  release(&dindex.lock);
+}
+
+// The name cache remembers what recent lookups found: the
+// inode number and dirent offset a name has in a directory, or
+// that it has none (a negative entry, inum 0). dirlink() and
+// dirunlink() update it along with the directory, under the
+// directory's lock, so it always agrees with the disk. Entries
+// live on one LRU list, most recently used first, and hash
+// chains of NDCHAIN heads; dcache.lock protects both.
+
+struct dentry {
+  uint dev;
+  uint dir;           // inode number of the directory
+  uint inum;          // inode number of the name, 0 if absent
+  uint off;           // byte offset of its dirent
+  char name[DIRSIZ];
+  struct dentry *prev; // LRU list
+  struct dentry *next;
+  struct dentry *hnext; // hash chain
+};
+
+struct {
+  struct spinlock lock;
+  struct dentry entry[NDENTRY];
+  struct dentry head;
+  struct dentry *chain[NDCHAIN];
+} dcache;
+
+static void
+dcache_init(void)
+{
+  struct dentry *d;
+
+  initlock(&dcache.lock, "dcache");
+  dcache.head.prev = &dcache.head;
+  dcache.head.next = &dcache.head;
+  for(d = dcache.entry; d < dcache.entry+NDENTRY; d++){
+    d->next = dcache.head.next;
+    d->prev = &dcache.head;
+    dcache.head.next->prev = d;
+    dcache.head.next = d;
+  }
+}
+
+static struct dentry**
+dchain(uint dev, uint dir, char *name)
+{
+  return &dcache.chain[(dev * 31 + dir * 17 + dirhash(name)) % NDCHAIN];
+}
+
+// Move d to the front of the LRU list.
+static void
+dcache_touch(struct dentry *d)
+{
+  d->next->prev = d->prev;
+  d->prev->next = d->next;
+  d->next = dcache.head.next;
+  d->prev = &dcache.head;
+  dcache.head.next->prev = d;
+  dcache.head.next = d;
+}
+
+// Return the entry for name in directory dir, or 0.
+// Caller must hold dcache.lock.
+static struct dentry*
+dcache_find(uint dev, uint dir, char *name)
+{
+  struct dentry *d;
+
+  for(d = *dchain(dev, dir, name); d; d = d->hnext)
+    if(d->dir == dir && d->dev == dev && namecmp(name, d->name) == 0)
+      return d;
+  return 0;
+}
+
+// Take d off its hash chain, if it is on one.
+// Caller must hold dcache.lock.
+static void
+dcache_unchain(struct dentry *d)
+{
+  struct dentry **pp;
+
+  if(d->dir == 0)
+    return;
+  for(pp = dchain(d->dev, d->dir, d->name); *pp != d; pp = &(*pp)->hnext)
+    ;
+  *pp = d->hnext;
+  d->dir = 0;
+}
+
+// Record that name has inode inum at offset off in directory
+// dp, or no inode if inum is 0. Caller must hold dp->lock.
+static void
+dcache_enter(struct inode *dp, char *name, uint inum, uint off)
+{
+  struct dentry *d, **pp;
+
+  acquire(&dcache.lock);
+  if((d = dcache_find(dp->dev, dp->inum, name)) == 0){
+    d = dcache.head.prev;
+    dcache_unchain(d);
+    d->dev = dp->dev;
+    d->dir = dp->inum;
+    strncpy(d->name, name, DIRSIZ);
+    pp = dchain(d->dev, d->dir, d->name);
+    d->hnext = *pp;
+    *pp = d;
+  }
+  d->inum = inum;
+  d->off = off;
+  dcache_touch(d);
+  release(&dcache.lock);
+}
+
+// Look name up in directory dir without reading it. Returns 0
+// if the cache does not know, else 1, setting *ipp to the inode
+// name refers to (with a new reference), or to 0 if it has none.
+static int
+dcache_lookup(uint dev, uint dir, char *name, struct inode **ipp, uint *poff)
+{
+  struct dentry *d;
+
+  acquire(&dcache.lock);
+  if((d = dcache_find(dev, dir, name)) == 0){
+    release(&dcache.lock);
+    return 0;
+  }
+  dcache_touch(d);
+  // Take the reference before letting go of dcache.lock, so
+  // that an unlink can't free the inode in between.
+  *ipp = d->inum ? iget(dev, d->inum) : 0;
+  if(poff)
+    *poff = d->off;
+  release(&dcache.lock);
+  return 1;
+}
+
+// Forget the entries of directory dir, which is being freed.
+static void
+dcache_purge(uint dev, uint dir)
+{
+  struct dentry *d;
+
+  acquire(&dcache.lock);
+  for(d = dcache.entry; d < dcache.entry+NDENTRY; d++)
+    if(d->dir == dir && d->dev == dev)
+      dcache_unchain(d);
+  release(&dcache.lock);
+}
+
+// Return the inode number name has in dp, or 0, setting *poff
+// to the byte offset of its entry. Uses the index x if it is
+// not 0, else reads dp a block at a time.
+static uint
+dirfind(struct inode *dp, struct dirindex *x, char *name, uint *poff)
+{
+  uint off, n, h, inum;
+  struct buf *bp;
+  struct dirent *de, d;
+
+  if(x){
+    for(h = dirhash(name); x->slot[h]; h = (h + 1) % DIRINDEXSLOTS){
+      off = (x->slot[h] - 1) * sizeof(d);
+      if(readi(dp, (char*)&d, off, sizeof(d)) != sizeof(d))
+        panic("dirfind read");
+      if(d.inum != 0 && namecmp(name, d.name) == 0){
+        *poff = off;
+        return d.inum;
+      }
+    }
+    return 0;
+  }
+
+  for(off = 0; off < dp->size; off += BSIZE){
+    bp = bread(dp->dev, bmap(dp, off / BSIZE));
+    n = dp->size - off < BSIZE ? dp->size - off : BSIZE;
+    for(de = (struct dirent*)bp->data; (uchar*)de < bp->data + n; de++){
+      if(de->inum != 0 && namecmp(name, de->name) == 0){
+        // entry matches path element
+        *poff = off + ((uchar*)de - bp->data);
+        inum = de->inum;
+        brelse(bp);
+        return inum;
+      }
+    }
+    brelse(bp);
+  }
+  return 0;
+}
+
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
 struct inode*
 dirlookup(struct inode *dp, char *name, uint *poff)
 {
   uint off, inum;
-  struct dirent de;
+  struct dirindex *x;
+  struct inode *ip;
 
   if(dp->type != T_DIR)
     panic("dirlookup not DIR");
 
-  for(off = 0; off < dp->size; off += sizeof(de)){
-    if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
-      panic("dirlookup read");
-    if(de.inum == 0)
-      continue;
-    if(namecmp(name, de.name) == 0){
-      // entry matches path element
-      if(poff)
-        *poff = off;
-      inum = de.inum;
-      return iget(dp->dev, inum);
-    }
-  }
+  if(dcache_lookup(dp->dev, dp->inum, name, &ip, poff))
+    return ip;
 
-  return 0;
+  off = 0;
+  x = dirindex_get(dp);
+  inum = dirfind(dp, x, name, &off);
+  if(x)
+    dirindex_put(x);
+  dcache_enter(dp, name, inum, off);
+  if(inum == 0)
+    return 0;
+  if(poff)
+    *poff = off;
+  return iget(dp->dev, inum);
 }
 
 // Write a new directory entry (name, inum) into the directory dp.
 int
 dirlink(struct inode *dp, char *name, uint inum)
 {
-  int off;
-  struct dirent de;
+  uint off, n;
+  struct dirent de, *e;
+  struct dirindex *x;
   struct inode *ip;
+  struct buf *bp;
 
   // Check that name is not present.
   if((ip = dirlookup(dp, name, 0)) != 0){
@@ -561,22 +1248,65 @@ dirlink(struct inode *dp, char *name, uint inum)
     return -1;
   }
 
-  // Look for an empty dirent.
-  for(off = 0; off < dp->size; off += sizeof(de)){
-    if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
-      panic("dirlink read");
-    if(de.inum == 0)
+  // Look for an empty dirent, a block at a time.
+  x = dirindex_get(dp);
+  for(off = x ? x->freeoff - x->freeoff % BSIZE : 0; off < dp->size; off += BSIZE){
+    bp = bread(dp->dev, bmap(dp, off / BSIZE));
+    n = dp->size - off < BSIZE ? dp->size - off : BSIZE;
+    for(e = (struct dirent*)bp->data; (uchar*)e < bp->data + n; e++)
+      if(e->inum == 0)
+        break;
+    if((uchar*)e < bp->data + n){
+      off += (uchar*)e - bp->data;
+      brelse(bp);
       break;
+    }
+    brelse(bp);
   }
+  if(off > dp->size)
+    off = dp->size;
 
   strncpy(de.name, name, DIRSIZ);
   de.inum = inum;
   if(writei(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
     panic("dirlink");
-
+  dcache_enter(dp, de.name, inum, off);
+
+  if(x){
+    if(x->nused >= DIRINDEXSLOTS * 3 / 4){
+      if(dirindex_build(dp, x) < 0){
+        acquire(&dindex.lock);
+        x->inum = 0;
+        release(&dindex.lock);
+      }
+    } else
+      dirindex_insert(x, de.name, off);
+    x->freeoff = off + sizeof(de);
+    dirindex_put(x);
+  }
   return 0;
 }
 
+// Clear the directory entry at byte offset off in dp.
+void
+dirunlink(struct inode *dp, uint off)
+{
+  struct dirent de;
+  struct dirindex *x;
+
+  if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
+    panic("dirunlink read");
+  dcache_enter(dp, de.name, 0, 0);
+  memset(&de, 0, sizeof(de));
+  if(writei(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
+    panic("dirunlink");
+  if((x = dirindex_get(dp)) != 0){
+    if(off < x->freeoff)
+      x->freeoff = off;
+    dirindex_put(x);
+  }
+}
+
 //PAGEBREAK!
 // Paths
 
@@ -632,6 +1362,16 @@ namex(char *path, int nameiparent, char *name)
     ip = idup(myproc()->cwd);
 
   while((path = skipelem(path, name)) != 0){
+    // A directory the name cache knows the answer for need
+    // not be locked or read.
+    if(!(nameiparent && *path == '\0') &&
+       dcache_lookup(ip->dev, ip->inum, name, &next, 0)){
+      iput(ip);
+      if(next == 0)
+        return 0;
+      ip = next;
+      continue;
+    }
     ilock(ip);
     if(ip->type != T_DIR){
       iunlockput(ip);
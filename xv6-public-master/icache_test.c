@@ -0,0 +1,75 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define NFILES 300
+#define ROUNDS 10
+
+// File i's name, in a buffer of at least 8 bytes.
+void filename(char *name, int i)
+{
+    name[0] = 'i';
+    name[1] = 'c';
+    name[2] = '0' + i / 100;
+    name[3] = '0' + i / 10 % 10;
+    name[4] = '0' + i % 10;
+    name[5] = 0;
+}
+
+int main(int argc, char *argv[])
+{
+    char name[8];
+    struct stat st;
+    uint hits, misses, hits0, misses0;
+
+    if(mkdir("icdir") < 0 || chdir("icdir") < 0)
+    {
+        printf(2, "ERROR: cannot make icdir!\n");
+        exit();
+    }
+
+    for(int i = 0; i < NFILES; i++)
+    {
+        filename(name, i);
+        int fd = open(name, O_CREATE | O_RDWR);
+        if(fd < 0)
+        {
+            printf(2, "ERROR: cannot create %s!\n", name);
+            exit();
+        }
+        close(fd);
+    }
+
+    // Stat a working set larger than the old 50-entry cache;
+    // after the first round every lookup should hit.
+    get_icache_stats(&hits0, &misses0);
+    int start = uptime();
+    for(int r = 0; r < ROUNDS; r++)
+    {
+        for(int i = 0; i < NFILES; i++)
+        {
+            filename(name, i);
+            if(stat(name, &st) < 0)
+            {
+                printf(2, "ERROR: cannot stat %s!\n", name);
+                exit();
+            }
+        }
+    }
+    int elapsed = uptime() - start;
+    get_icache_stats(&hits, &misses);
+
+    printf(1, "%d stats of %d files in %d ticks\n", ROUNDS * NFILES, NFILES, elapsed);
+    printf(1, "inode cache: %d hits, %d misses\n", hits - hits0, misses - misses0);
+
+    for(int i = 0; i < NFILES; i++)
+    {
+        filename(name, i);
+        unlink(name);
+    }
+    chdir("..");
+    unlink("icdir");
+
+    exit();
+}
@@ -24,12 +24,20 @@
 #define IDE_CMD_RDMUL 0xc4
 #define IDE_CMD_WRMUL 0xc5
 
+// Most blocks the driver moves in one command.
+#define IDE_MAXMERGE  32
+
 // idequeue points to the buf now being read/written to the disk.
 // idequeue->qnext points to the next buf to be processed.
+// The first nactive bufs make up the transfer in progress:
+// queued requests for consecutive blocks going the same way
+// are merged into one multi-sector command. The rest of the
+// queue is kept in elevator order (see idequeue_add).
 // You must hold idelock while manipulating queue.
 
 static struct spinlock idelock;
 static struct buf *idequeue;
+static int nactive;
 
 static int havedisk1;
 static void idestart(struct buf*);
@@ -69,10 +77,13 @@ ideinit(void)
   outb(0x1f6, 0xe0 | (0<<4));
 }
 
-// Start the request for b.  Caller must hold idelock.
+// Start the request for b, merged with the queued requests
+// for the blocks that follow it.  Caller must hold idelock.
 static void
 idestart(struct buf *b)
 {
+  struct buf *q;
+
   if(b == 0)
     panic("idestart");
   if(b->blockno >= FSSIZE)
@@ -84,9 +95,20 @@ idestart(struct buf *b)
 
   if (sector_per_block > 7) panic("idestart");
 
+  // Single-sector blocks interrupt once per block, so a run
+  // of them can share one command. ideintr() moves the data.
+  nactive = 1;
+  if(sector_per_block == 1){
+    for(q = b; q->qnext && nactive < IDE_MAXMERGE; q = q->qnext, nactive++){
+      if(q->qnext->dev != b->dev || q->qnext->blockno != q->blockno + 1 ||
+         (q->qnext->flags & B_DIRTY) != (b->flags & B_DIRTY))
+        break;
+    }
+  }
+
   idewait(0);
   outb(0x3f6, 0);  // generate interrupt
-  outb(0x1f2, sector_per_block);  // number of sectors
+  outb(0x1f2, sector_per_block * nactive);  // number of sectors
   outb(0x1f3, sector & 0xff);
   outb(0x1f4, (sector >> 8) & 0xff);
   outb(0x1f5, (sector >> 16) & 0xff);
@@ -123,13 +145,66 @@ ideintr(void)
   b->flags &= ~B_DIRTY;
   wakeup(b);
 
-  // Start disk on next buf in queue.
-  if(idequeue != 0)
+  // Nobody waits for a read-ahead; release the buffer here.
+  if(b->flags & B_ASYNC){
+    b->flags &= ~B_ASYNC;
+    bdone(b);
+  }
+
+  if(--nactive > 0){
+    // The merged transfer goes on with the next buf; a write
+    // needs its data.
+    if(idequeue->flags & B_DIRTY){
+      idewait(0);
+      outsl(0x1f0, idequeue->data, BSIZE/4);
+    }
+  } else if(idequeue != 0)
+    // Start disk on next buf in queue.
     idestart(idequeue);
 
   release(&idelock);
 }
 
+// Position of blockno in a sweep of the disk that starts at
+// block head and wraps around to block 0.
+static uint
+sweeppos(uint blockno, uint head)
+{
+  return blockno >= head ? blockno - head : blockno + FSSIZE - head;
+}
+
+// Add b to idequeue. Waiting requests are served in one-way elevator (C-SCAN)
+// order: ascending block numbers from the transfer in
+// progress, then wrapping to the lowest. The caller starts
+// the disk if it is idle (nactive == 0). Caller must hold
+// idelock.
+static void
+idequeue_add(struct buf *b)
+{
+  struct buf **pp, *last;
+  int i;
+  uint pos;
+
+  b->qnext = 0;
+  if(idequeue == 0){
+    idequeue = b;
+    return;
+  }
+
+  // Skip the transfer in progress, then find b's place.
+  pp = &idequeue;
+  last = idequeue;
+  for(i = 0; i < nactive && *pp; i++){
+    last = *pp;
+    pp = &(*pp)->qnext;
+  }
+  pos = sweeppos(b->blockno, last->blockno);
+  while(*pp && sweeppos((*pp)->blockno, last->blockno) <= pos)  //DOC:insert-queue
+    pp = &(*pp)->qnext;
+  b->qnext = *pp;
+  *pp = b;
+}
+
 //PAGEBREAK!
 // Sync buf with disk.
 // If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
@@ -137,8 +212,6 @@ ideintr(void)
 void
 iderw(struct buf *b)
 {
-  struct buf **pp;
-
   if(!holdingsleep(&b->lock))
     panic("iderw: buf not locked");
   if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
@@ -148,15 +221,11 @@ iderw(struct buf *b)
 
   acquire(&idelock);  //DOC:acquire-lock
 
-  // Append b to idequeue.
-  b->qnext = 0;
-  for(pp=&idequeue; *pp; pp=&(*pp)->qnext)  //DOC:insert-queue
-    ;
-  *pp = b;
+  idequeue_add(b);
 
   // Start disk if necessary.
-  if(idequeue == b)
-    idestart(b);
+  if(nactive == 0)
+    idestart(idequeue);
 
   // Wait for request to finish.
   while((b->flags & (B_VALID|B_DIRTY)) != B_VALID){
@@ -166,3 +235,50 @@ iderw(struct buf *b)
 
   release(&idelock);
 }
+
+// Queue a read of locked buf b without waiting for it.
+// ideintr() releases b once the data is in; b must have
+// B_ASYNC set.
+void
+idereadahead(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("idereadahead: buf not locked");
+  if((b->flags & (B_VALID|B_DIRTY|B_ASYNC)) != B_ASYNC)
+    panic("idereadahead");
+  if(b->dev != 0 && !havedisk1)
+    panic("iderw: ide disk 1 not present");
+
+  acquire(&idelock);
+  idequeue_add(b);
+  if(nactive == 0)
+    idestart(idequeue);
+  release(&idelock);
+}
+
+// Like iderw() for n bufs at once. All of them are queued
+// before the disk starts, so neighbours can share a command.
+void
+iderwv(struct buf **bs, int n)
+{
+  int i;
+
+  for(i = 0; i < n; i++){
+    if(!holdingsleep(&bs[i]->lock))
+      panic("iderwv: buf not locked");
+    if((bs[i]->flags & (B_VALID|B_DIRTY)) == B_VALID)
+      panic("iderwv: nothing to do");
+    if(bs[i]->dev != 0 && !havedisk1)
+      panic("iderwv: ide disk 1 not present");
+  }
+
+  acquire(&idelock);
+  for(i = 0; i < n; i++)
+    idequeue_add(bs[i]);
+  if(nactive == 0 && idequeue != 0)
+    idestart(idequeue);
+  for(i = 0; i < n; i++)
+    while((bs[i]->flags & (B_VALID|B_DIRTY)) != B_VALID)
+      sleep(bs[i], &idelock);
+  release(&idelock);
+}
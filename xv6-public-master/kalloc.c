@@ -21,8 +21,25 @@ struct {
   struct spinlock lock;
   int use_lock;
   struct run *freelist;
+  int nfree;                    // Pages on freelist
+  ushort ref[PHYSTOP / PGSIZE]; // Mappings of each allocated page
 } kmem;
 
+// Free pages cached by each CPU in front of kmem.freelist, so
+// most kalloc() and kfree() calls only take the CPU's own,
+// uncontended lock. Pages move to and from kmem KBATCH at a
+// time. Other CPUs take the lock only to steal pages when
+// kmem runs dry.
+struct kcache {
+  struct spinlock lock;
+  struct run *freelist;
+  int nfree;
+} __attribute__((aligned(CACHELINE))) kcache[NCPU];
+
+#ifndef KJUNK
+#define KJUNK 1
+#endif
+
 // Initialization happens in two phases.
 // 1. main() calls kinit1() while still using entrypgdir to place just
 // the pages mapped by entrypgdir on free list.
@@ -31,7 +48,11 @@ struct {
 void
 kinit1(void *vstart, void *vend)
 {
+  int i;
+
   initlock(&kmem.lock, "kmem");
+  for(i = 0; i < NCPU; i++)
+    initlock(&kcache[i].lock, "kcache");
   kmem.use_lock = 0;
   freerange(vstart, vend);
 }
@@ -51,29 +72,165 @@ freerange(void *vstart, void *vend)
   for(; p + PGSIZE <= (char*)vend; p += PGSIZE)
     kfree(p);
 }
+// Lock and return this CPU's page cache.
+static struct kcache*
+lockcache(void)
+{
+  struct kcache *c;
+
+  pushcli();
+  c = &kcache[cpuid()];
+  acquire(&c->lock);
+  popcli();
+  return c;
+}
+
+// Move up to n pages from kmem.freelist to cache c.
+static void
+refill(struct kcache *c, int n)
+{
+  struct run *r;
+
+  acquire(&kmem.lock);
+  for(; n > 0 && (r = kmem.freelist) != 0; n--){
+    kmem.freelist = r->next;
+    kmem.nfree--;
+    r->next = c->freelist;
+    c->freelist = r;
+    c->nfree++;
+  }
+  release(&kmem.lock);
+}
+
+// Move n pages from cache c back to kmem.freelist.
+static void
+drain(struct kcache *c, int n)
+{
+  struct run *r;
+
+  acquire(&kmem.lock);
+  for(; n > 0 && (r = c->freelist) != 0; n--){
+    c->freelist = r->next;
+    c->nfree--;
+    r->next = kmem.freelist;
+    kmem.freelist = r;
+    kmem.nfree++;
+  }
+  release(&kmem.lock);
+}
+
+// Take one page from another CPU's cache, for when this
+// CPU's cache and kmem are both empty.
+static struct run*
+steal(void)
+{
+  struct run *r;
+  int i;
+
+  r = 0;
+  for(i = 0; i < NCPU && r == 0; i++){
+    acquire(&kcache[i].lock);
+    if((r = kcache[i].freelist) != 0){
+      kcache[i].freelist = r->next;
+      kcache[i].nfree--;
+    }
+    release(&kcache[i].lock);
+  }
+  return r;
+}
+
 //PAGEBREAK: 21
-// Free the page of physical memory pointed at by v,
-// which normally should have been returned by a
-// call to kalloc().  (The exception is when
-// initializing the allocator; see kinit above.)
+// Drop one reference to the page of physical memory pointed
+// at by v, which normally should have been returned by a
+// call to kalloc(), and free the page when none are left.
+// (The exception is when initializing the allocator; see
+// kinit above.)
 void
 kfree(char *v)
 {
   struct run *r;
+  struct kcache *c;
+  uint pn;
 
   if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
     panic("kfree");
 
+  // A page with one reference belongs to the caller alone, so
+  // only pages still shared copy-on-write need kmem.lock.
+  pn = V2P(v) / PGSIZE;
+  if(kmem.ref[pn] > 1){
+    if(kmem.use_lock)
+      acquire(&kmem.lock);
+    if(kmem.ref[pn] > 1){
+      kmem.ref[pn]--;
+      if(kmem.use_lock)
+        release(&kmem.lock);
+      return;
+    }
+    if(kmem.use_lock)
+      release(&kmem.lock);
+  }
+  kmem.ref[pn] = 0;
+
+#if KJUNK
   // Fill with junk to catch dangling refs.
   memset(v, 1, PGSIZE);
+#endif
 
+  r = (struct run*)v;
+  if(!kmem.use_lock){
+    // Still booting on one CPU, before cpuid() works.
+    r->next = kmem.freelist;
+    kmem.freelist = r;
+    kmem.nfree++;
+    return;
+  }
+
+  c = lockcache();
+  r->next = c->freelist;
+  c->freelist = r;
+  c->nfree++;
+  if(c->nfree > KCACHE)
+    drain(c, KBATCH);
+  release(&c->lock);
+}
+
+// Add a reference to the allocated page at v, for
+// sharing it copy-on-write.
+void
+kincref(char *v)
+{
   if(kmem.use_lock)
     acquire(&kmem.lock);
-  r = (struct run*)v;
-  r->next = kmem.freelist;
-  kmem.freelist = r;
+  kmem.ref[V2P(v) / PGSIZE]++;
+  if(kmem.use_lock)
+    release(&kmem.lock);
+}
+
+// Number of references to the allocated page at v.
+int
+krefcount(char *v)
+{
+  int n;
+
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  n = kmem.ref[V2P(v) / PGSIZE];
   if(kmem.use_lock)
     release(&kmem.lock);
+  return n;
+}
+
+// Number of free pages, including those in CPU caches.
+int
+kfreecount(void)
+{
+  int i, n;
+
+  n = kmem.nfree;
+  for(i = 0; i < NCPU; i++)
+    n += kcache[i].nfree;
+  return n;
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -83,14 +240,30 @@ char*
 kalloc(void)
 {
   struct run *r;
+  struct kcache *c;
 
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
-  r = kmem.freelist;
+  if(!kmem.use_lock){
+    r = kmem.freelist;
+    if(r){
+      kmem.freelist = r->next;
+      kmem.nfree--;
+    }
+  } else {
+    c = lockcache();
+    if(c->freelist == 0)
+      refill(c, KBATCH);
+    r = c->freelist;
+    if(r){
+      c->freelist = r->next;
+      c->nfree--;
+    }
+    release(&c->lock);
+    if(r == 0)
+      r = steal();
+  }
+
+  // Nobody else can see a page just taken off a free list.
   if(r)
-    kmem.freelist = r->next;
-  if(kmem.use_lock)
-    release(&kmem.lock);
+    kmem.ref[V2P(r) / PGSIZE] = 1;
   return (char*)r;
 }
-
@@ -0,0 +1,47 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "bench.h"
+
+#define PAGES 64
+
+// workers, rounds per worker
+int args[] = { 4, 200 };
+
+// Grow, touch and release the heap, and fork a child that
+// writes into it, so the run is dominated by kalloc() and
+// kfree().
+void job(int i)
+{
+    for(int j = 0; j < args[1]; j++)
+    {
+        char *heap = sbrk(PAGES * 4096);
+
+        if(heap == (char*)-1)
+        {
+            printf(2, "ERROR: sbrk failed!\n");
+            exit();
+        }
+        for(int k = 0; k < PAGES; k++)
+            heap[k * 4096] = k;
+
+        if(fork() == 0)
+        {
+            heap[0] = 1;
+            exit();
+        }
+        wait();
+
+        sbrk(-PAGES * 4096);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    benchargs(argc, argv, args, 2, "kalloc_scaling_test [workers] [rounds]");
+
+    int elapsed = runjobs(args[0], job);
+    printrate(args[0], "workers", args[1] * PAGES, "pages", elapsed);
+
+    exit();
+}
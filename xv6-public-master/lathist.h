@@ -0,0 +1,11 @@
+// System call latency histogram, one row per system call number
+// (row num-1 for call num). Bucket b counts calls that took
+// [2^(b+LATSHIFT), 2^(b+LATSHIFT+1)) rdtsc cycles; the first and
+// last buckets also take everything below and above that range.
+// Sized to fit in one page.
+#define LATSHIFT     6
+#define NLATBUCKET  24
+
+struct lathist {
+  uint count[MAX_SYSCALLS][NLATBUCKET];
+};
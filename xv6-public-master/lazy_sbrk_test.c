@@ -0,0 +1,65 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define HEAP_PAGES 8192
+#define TOUCH_PAGES 64
+#define ROUNDS 100
+
+int main(int argc, char *argv[])
+{
+    int heap_pages = HEAP_PAGES;
+
+    if(argc > 2)
+    {
+        printf(2, "usage: lazy_sbrk_test [pages]\n");
+        exit();
+    }
+
+    if(argc > 1)
+        heap_pages = atoi(argv[1]);
+
+    // Reserving a large heap should cost no pages up front.
+    int before = get_free_pages();
+    char *heap = sbrk(heap_pages * 4096);
+    if(heap == (char*)-1)
+    {
+        printf(2, "ERROR: sbrk failed!\n");
+        exit();
+    }
+    int reserved = before - get_free_pages();
+
+    // Only the pages actually touched get backed.
+    int touch = heap_pages < TOUCH_PAGES ? heap_pages : TOUCH_PAGES;
+    for(int i = 0; i < touch; i++)
+        heap[i * 4096] = i;
+    int touched = before - get_free_pages();
+
+    for(int i = 0; i < touch; i++)
+    {
+        if(heap[i * 4096] != (char)i)
+        {
+            printf(2, "ERROR: page %d lost its contents!\n", i);
+            exit();
+        }
+    }
+
+    sbrk(-heap_pages * 4096);
+
+    // Grow-and-release rounds, like a program that reserves a
+    // big arena at start-up and exits after using a little of it.
+    int start = uptime();
+    for(int i = 0; i < ROUNDS; i++)
+    {
+        heap = sbrk(heap_pages * 4096);
+        heap[0] = 1;
+        sbrk(-heap_pages * 4096);
+    }
+    int elapsed = uptime() - start;
+
+    printf(1, "sbrk of %d pages takes %d pages, %d after touching %d\n",
+           heap_pages, reserved, touched, touch);
+    printf(1, "%d sbrk rounds in %d ticks\n", ROUNDS, elapsed);
+
+    exit();
+}
@@ -18,7 +18,13 @@
 // its start and end. Usually begin_op() just increments
 // the count of in-progress FS system calls and returns.
 // But if it thinks the log is close to running out, it
-// sleeps until the last outstanding end_op() commits.
+// asks for a commit and sleeps until it is done.
+//
+// Commits run in the background, in the logd kernel process.
+// end_op() does not wait for one: logd commits LOGDELAY ticks
+// after the first update of a transaction, so the system calls
+// ending in that window share one commit (group commit).
+// Callers that need their updates on disk use log_sync().
 //
 // The log is a physical re-do log containing disk blocks.
 // The on-disk log format:
@@ -27,7 +33,8 @@
 //   block B
 //   block C
 //   ...
-// Log appends are synchronous.
+// Each commit writes all its log blocks, then all the home
+// locations, as one batch, so the disk can merge and sort them.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
@@ -42,6 +49,9 @@ struct log {
   int size;
   int outstanding; // how many FS sys calls are executing.
   int committing;  // in commit(), please wait.
+  int wantcommit;  // commit due; new sys calls wait for it.
+  uint since;      // ticks at the first update since the last commit.
+  uint ncommit;    // commits done, for log_sync().
   int dev;
   struct logheader lh;
 };
@@ -49,6 +59,7 @@ struct log log;
 
 static void recover_from_log(void);
 static void commit();
+static void logdaemon(void);
 
 void
 initlog(int dev)
@@ -63,6 +74,7 @@ initlog(int dev)
   log.size = sb.nlog;
   log.dev = dev;
   recover_from_log();
+  kproc("logd", logdaemon);
 }
 
 // Copy committed blocks from log to their home location
@@ -70,15 +82,17 @@ static void
 install_trans(void)
 {
   int tail;
+  struct buf *dbuf[LOGSIZE];
 
   for (tail = 0; tail < log.lh.n; tail++) {
     struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
+    dbuf[tail] = bread(log.dev, log.lh.block[tail]); // read dst
+    memmove(dbuf[tail]->data, lbuf->data, BSIZE);  // copy block to dst
     brelse(lbuf);
-    brelse(dbuf);
   }
+  bwritev(dbuf, log.lh.n);  // write dsts to disk
+  for (tail = 0; tail < log.lh.n; tail++)
+    brelse(dbuf[tail]);
 }
 
 // Read the log header from disk into the in-memory log header
@@ -127,10 +141,14 @@ begin_op(void)
 {
   acquire(&log.lock);
   while(1){
-    if(log.committing){
+    if(log.committing || log.wantcommit){
       sleep(&log, &log.lock);
     } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
-      // this op might exhaust log space; wait for commit.
+      // this op might exhaust log space; ask for a commit.
+      if(log.lh.n > 0){
+        log.wantcommit = 1;
+        wakeup(&log.lh);
+      }
       sleep(&log, &log.lock);
     } else {
       log.outstanding += 1;
@@ -141,35 +159,75 @@ begin_op(void)
 }
 
 // called at the end of each FS system call.
-// commits if this was the last outstanding operation.
+// logd commits later, once no operation is outstanding.
 void
 end_op(void)
 {
-  int do_commit = 0;
-
   acquire(&log.lock);
   log.outstanding -= 1;
   if(log.committing)
     panic("log.committing");
-  if(log.outstanding == 0){
-    do_commit = 1;
-    log.committing = 1;
-  } else {
-    // begin_op() may be waiting for log space,
-    // and decrementing log.outstanding has decreased
-    // the amount of reserved space.
-    wakeup(&log);
+  // begin_op() may be waiting for log space,
+  // and decrementing log.outstanding has decreased
+  // the amount of reserved space.
+  wakeup(&log);
+  if(log.outstanding == 0)
+    wakeup(&log.lh);  // logd may be waiting to commit
+  release(&log.lock);
+}
+
+// Wait until the updates of every FS system call that has
+// ended are on disk.
+void
+log_sync(void)
+{
+  uint target;
+
+  acquire(&log.lock);
+  if(log.lh.n > 0 || log.committing){
+    // A commit in progress holds all ended calls' updates.
+    target = log.ncommit + 1;
+    if(!log.committing){
+      log.wantcommit = 1;
+      wakeup(&log.lh);
+    }
+    while((int)(log.ncommit - target) < 0)
+      sleep(&log, &log.lock);
   }
   release(&log.lock);
+}
 
-  if(do_commit){
+// Body of the logd kernel process.
+static void
+logdaemon(void)
+{
+  acquire(&log.lock);
+  for(;;){
+    if(log.lh.n == 0){
+      sleep(&log.lh, &log.lock);
+      continue;
+    }
+    // Give more system calls a chance to join this commit.
+    if(!log.wantcommit && ticks - log.since < LOGDELAY){
+      sleep(&ticks, &log.lock);
+      continue;
+    }
+    // Hold off new calls until the running ones end.
+    log.wantcommit = 1;
+    if(log.outstanding > 0){
+      sleep(&log.lh, &log.lock);
+      continue;
+    }
+    log.wantcommit = 0;
+    log.committing = 1;
     // call commit w/o holding locks, since not allowed
     // to sleep with locks.
+    release(&log.lock);
     commit();
     acquire(&log.lock);
     log.committing = 0;
+    log.ncommit++;
     wakeup(&log);
-    release(&log.lock);
   }
 }
 
@@ -178,15 +236,17 @@ static void
 write_log(void)
 {
   int tail;
+  struct buf *to[LOGSIZE];
 
   for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
+    to[tail] = bread(log.dev, log.start+tail+1); // log block
     struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
+    memmove(to[tail]->data, from->data, BSIZE);
     brelse(from);
-    brelse(to);
   }
+  bwritev(to, log.lh.n);  // write the log
+  for (tail = 0; tail < log.lh.n; tail++)
+    brelse(to[tail]);
 }
 
 static void
@@ -226,8 +286,11 @@ log_write(struct buf *b)
       break;
   }
   log.lh.block[i] = b->blockno;
-  if (i == log.lh.n)
+  if (i == log.lh.n) {
+    if (log.lh.n == 0)
+      log.since = ticks;
     log.lh.n++;
+  }
   b->flags |= B_DIRTY; // prevent eviction
   release(&log.lock);
 }
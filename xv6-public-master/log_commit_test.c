@@ -0,0 +1,85 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define DEFAULT_WRITERS 4
+#define WRITES 100
+
+char buf[64];
+
+void name(char *s, int i)
+{
+    strcpy(s, "logtest0");
+    s[7] = '0' + i;
+}
+
+// Every writer appends WRITES small records to its own file,
+// each write its own log transaction; with sync set, each one
+// also waits for the commit. Returns the ticks taken.
+int run(int writers, int sync)
+{
+    char file[16];
+    int start = uptime();
+
+    for(int i = 0; i < writers; i++)
+    {
+        if(fork() == 0)
+        {
+            name(file, i);
+            int fd = open(file, O_CREATE | O_RDWR);
+
+            if(fd < 0)
+            {
+                printf(2, "ERROR: cannot create %s!\n", file);
+                exit();
+            }
+            for(int j = 0; j < WRITES; j++)
+            {
+                write(fd, buf, sizeof(buf));
+                if(sync)
+                    fsync(fd);
+            }
+            close(fd);
+            exit();
+        }
+    }
+
+    while(wait() != -1)
+        ;
+
+    int elapsed = uptime() - start;
+
+    for(int i = 0; i < writers; i++)
+    {
+        name(file, i);
+        unlink(file);
+    }
+
+    return elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+    int writers = DEFAULT_WRITERS;
+
+    if(argc > 2)
+    {
+        printf(2, "usage: log_commit_test [writers]\n");
+        exit();
+    }
+
+    if(argc > 1)
+        writers = atoi(argv[1]);
+    if(writers > 10)
+        writers = 10;
+
+    memset(buf, 'a', sizeof(buf));
+
+    printf(1, "%d writers x %d writes, group commit: %d ticks\n",
+           writers, WRITES, run(writers, 0));
+    printf(1, "%d writers x %d writes, fsync after each: %d ticks\n",
+           writers, WRITES, run(writers, 1));
+
+    exit();
+}
@@ -28,8 +28,10 @@ main(void)
   uartinit();      // serial port
   pinit();         // process table
   tvinit();        // trap vectors
+  traceinit();     // scheduler tracing
   binit();         // buffer cache
   fileinit();      // file table
+  init_sharedmem(); // shared memory table
   ideinit();       // disk 
   startothers();   // start other processors
   kinit2(P2V(4*1024*1024), P2V(PHYSTOP)); // must come after startothers()
@@ -58,3 +58,21 @@ iderw(struct buf *b)
     memmove(b->data, p, BSIZE);
   b->flags |= B_VALID;
 }
+
+// The memory disk has no latency to hide: read now.
+void
+idereadahead(struct buf *b)
+{
+  b->flags &= ~B_ASYNC;
+  iderw(b);
+  bdone(b);
+}
+
+void
+iderwv(struct buf **bs, int n)
+{
+  int i;
+
+  for(i = 0; i < n; i++)
+    iderw(bs[i]);
+}
@@ -1,21 +1,41 @@
-#define NPROC        64  // maximum number of processes
+#define NPROC      1024  // maximum number of processes
 #define KSTACKSIZE 4096  // size of per-process kernel stack
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
 #define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
+#define NINODE     2048  // maximum number of active i-nodes
+#define NIBUCKET    127  // inode cache hash buckets
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
-#define MAXOPBLOCKS  10  // max # of blocks any FS op writes
+#define MAXSEG        4  // ELF segments exec() pages in on demand
+#define KCACHE       64  // max free pages in each CPU's kalloc cache
+#define KBATCH       16  // pages moved between a CPU cache and kmem
+#define MAX_SHARED_SEGS 16  // shared memory segments in the system
+#define SHMPAGES     16  // max pages in one shared memory segment
+#define NPROCSHM      4  // shared memory segments one process can map
+#define MAXOPBLOCKS  32  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define NBUF         512  // size of disk block cache
+#define NBUCKET       61  // buffer cache hash buckets
+#define NREADAHEAD    8  // blocks read ahead of sequential file reads
+#define NDIRINDEX     8  // directories with an in-memory hash index
+#define DIRINDEXSLOTS 4096  // slots in one directory index
+#define DIRINDEXMIN 2048  // bytes a directory needs to get an index
+#define NDENTRY    1024  // path name lookups remembered by the name cache
+#define NDCHAIN     127  // name cache hash chains
+#define LOGDELAY      2  // ticks the log waits for more ops before committing
+#define FSSIZE       40000  // size of file system in blocks
+#define NINODES      4096  // inodes mkfs makes
+#define CACHELINE    64  // size of a cache line in bytes
+#define NTRACE      512  // scheduler trace events buffered per CPU
+#define MAX_SYSCALLS 40  // system calls tracked per process, numbered from 1
 #define SYS_TICK 10
 #define QUANTUM 50
 #define DEFAULT_BURST_TIME 2
 #define DEFAULT_CONFIDENCE 50
 #define STARVATION_BOUNDRY 800
+#define AGING_WHEEL 1024  // aging timer wheel slots, > STARVATION_BOUNDRY
 #define TIME_SLICE_UNIT 100
 #define RR_WEIGHT 3
 #define SJF_WEIGHT 2
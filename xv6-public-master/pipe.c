@@ -8,21 +8,38 @@
 #include "sleeplock.h"
 #include "file.h"
 
-#define PIPESIZE 512
+// The ring is made of separate pages so that whole pages can
+// move between the pipe and page-aligned user buffers without
+// copying: pipewrite() shares the writer's page copy-on-write,
+// and piperead() swaps it with the reader's page.
+#define PIPEPAGES 4
+#define PIPESIZE (PIPEPAGES*PGSIZE)
 
 struct pipe {
   struct spinlock lock;
-  char data[PIPESIZE];
+  char *data[PIPEPAGES];  // ring pages, possibly shared copy-on-write
   uint nread;     // number of bytes read
   uint nwrite;    // number of bytes written
   int readopen;   // read fd is still open
   int writeopen;  // write fd is still open
 };
 
+static void
+freepipe(struct pipe *p)
+{
+  int i;
+
+  for(i = 0; i < PIPEPAGES; i++)
+    if(p->data[i])
+      kfree(p->data[i]);
+  kfree((char*)p);
+}
+
 int
 pipealloc(struct file **f0, struct file **f1)
 {
   struct pipe *p;
+  int i;
 
   p = 0;
   *f0 = *f1 = 0;
@@ -30,6 +47,11 @@ pipealloc(struct file **f0, struct file **f1)
     goto bad;
   if((p = (struct pipe*)kalloc()) == 0)
     goto bad;
+  for(i = 0; i < PIPEPAGES; i++)
+    p->data[i] = 0;
+  for(i = 0; i < PIPEPAGES; i++)
+    if((p->data[i] = kalloc()) == 0)
+      goto bad;
   p->readopen = 1;
   p->writeopen = 1;
   p->nwrite = 0;
@@ -48,7 +70,7 @@ pipealloc(struct file **f0, struct file **f1)
 //PAGEBREAK: 20
  bad:
   if(p)
-    kfree((char*)p);
+    freepipe(p);
   if(*f0)
     fileclose(*f0);
   if(*f1)
@@ -69,19 +91,38 @@ pipeclose(struct pipe *p, int writable)
   }
   if(p->readopen == 0 && p->writeopen == 0){
     release(&p->lock);
-    kfree((char*)p);
+    freepipe(p);
   } else
     release(&p->lock);
 }
 
+// Give ring page k a private copy before writing into it,
+// if it is still shared with a writer's user page.
+static int
+unshare(struct pipe *p, int k)
+{
+  char *mem;
+
+  if(krefcount(p->data[k]) == 1)
+    return 0;
+  if((mem = kalloc()) == 0)
+    return -1;
+  memmove(mem, p->data[k], PGSIZE);
+  kfree(p->data[k]);
+  p->data[k] = mem;
+  return 0;
+}
+
 //PAGEBREAK: 40
 int
 pipewrite(struct pipe *p, char *addr, int n)
 {
-  int i;
+  int i, k, m;
+  uint off;
+  char *page;
 
   acquire(&p->lock);
-  for(i = 0; i < n; i++){
+  for(i = 0; i < n; i += m){
     while(p->nwrite == p->nread + PIPESIZE){  //DOC: pipewrite-full
       if(p->readopen == 0 || myproc()->killed){
         release(&p->lock);
@@ -90,7 +131,29 @@ pipewrite(struct pipe *p, char *addr, int n)
       wakeup(&p->nread);
       sleep(&p->nwrite, &p->lock);  //DOC: pipewrite-sleep
     }
-    p->data[p->nwrite++ % PIPESIZE] = addr[i];
+    off = p->nwrite % PIPESIZE;
+    k = off / PGSIZE;
+    if(off % PGSIZE == 0 && n - i >= PGSIZE && (uint)(addr + i) % PGSIZE == 0 &&
+       p->nread + PIPESIZE - p->nwrite >= PGSIZE &&
+       (page = lendpage(myproc()->pgdir, (uint)(addr + i))) != 0){
+      // A whole user page fills a whole free ring page: share it.
+      kfree(p->data[k]);
+      p->data[k] = page;
+      m = PGSIZE;
+    } else {
+      m = n - i;
+      if(m > p->nread + PIPESIZE - p->nwrite)
+        m = p->nread + PIPESIZE - p->nwrite;
+      if(m > PGSIZE - off % PGSIZE)
+        m = PGSIZE - off % PGSIZE;
+      if(unshare(p, k) < 0){
+        wakeup(&p->nread);
+        release(&p->lock);
+        return i > 0 ? i : -1;
+      }
+      memmove(p->data[k] + off % PGSIZE, addr + i, m);
+    }
+    p->nwrite += m;
   }
   wakeup(&p->nread);  //DOC: pipewrite-wakeup1
   release(&p->lock);
@@ -100,7 +163,8 @@ pipewrite(struct pipe *p, char *addr, int n)
 int
 piperead(struct pipe *p, char *addr, int n)
 {
-  int i;
+  int i, k, m;
+  uint off;
 
   acquire(&p->lock);
   while(p->nread == p->nwrite && p->writeopen){  //DOC: pipe-empty
@@ -110,10 +174,23 @@ piperead(struct pipe *p, char *addr, int n)
     }
     sleep(&p->nread, &p->lock); //DOC: piperead-sleep
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
-    if(p->nread == p->nwrite)
-      break;
-    addr[i] = p->data[p->nread++ % PIPESIZE];
+  for(i = 0; i < n && p->nread != p->nwrite; i += m){  //DOC: piperead-copy
+    off = p->nread % PIPESIZE;
+    k = off / PGSIZE;
+    if(off % PGSIZE == 0 && n - i >= PGSIZE && (uint)(addr + i) % PGSIZE == 0 &&
+       p->nwrite - p->nread >= PGSIZE &&
+       swappage(myproc()->pgdir, (uint)(addr + i), &p->data[k]) == 0){
+      // A whole ring page fills a whole user page: move it.
+      m = PGSIZE;
+    } else {
+      m = n - i;
+      if(m > p->nwrite - p->nread)
+        m = p->nwrite - p->nread;
+      if(m > PGSIZE - off % PGSIZE)
+        m = PGSIZE - off % PGSIZE;
+      memmove(addr + i, p->data[k] + off % PGSIZE, m);
+    }
+    p->nread += m;
   }
   wakeup(&p->nwrite);  //DOC: piperead-wakeup
   release(&p->lock);
@@ -0,0 +1,71 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define TOTAL (4 * 1024 * 1024)
+#define PAGE 4096
+
+// Send TOTAL bytes through a pipe in writes of chunk bytes from
+// wbuf, read them into rbuf, and report MB/s. Ticks are 10ms.
+void run(char *label, char *wbuf, char *rbuf, int chunk)
+{
+    int fds[2];
+
+    if(pipe(fds) < 0)
+    {
+        printf(2, "ERROR: pipe failed!\n");
+        exit();
+    }
+
+    int start = uptime();
+
+    if(fork() == 0)
+    {
+        close(fds[0]);
+        for(int sent = 0; sent < TOTAL; sent += chunk)
+        {
+            wbuf[0] = sent / chunk;
+            if(write(fds[1], wbuf, chunk) != chunk)
+            {
+                printf(2, "ERROR: write failed!\n");
+                break;
+            }
+        }
+        exit();
+    }
+
+    close(fds[1]);
+
+    int got = 0, n;
+    while((n = read(fds[0], rbuf, chunk)) > 0)
+        got += n;
+    close(fds[0]);
+    wait();
+
+    int elapsed = uptime() - start;
+    if(elapsed == 0)
+        elapsed = 1;
+
+    int kbps = got / 1024 * 100 / elapsed;
+
+    printf(1, "%s: %d bytes in %d ticks, %d.%d MB/s\n",
+           label, got, elapsed, kbps / 1024, kbps % 1024 * 10 / 1024);
+}
+
+int main(int argc, char *argv[])
+{
+    // Page-aligned buffers so whole pages can move between the
+    // pipe and the processes.
+    char *base = sbrk(4 * PAGE);
+    char *wbuf = (char*)(((uint)base + PAGE - 1) & ~(PAGE - 1));
+    char *rbuf = wbuf + 2 * PAGE;
+
+    memset(wbuf, 'x', PAGE);
+    memset(rbuf, 0, PAGE);
+
+    run("page-aligned 4096-byte writes", wbuf, rbuf, PAGE);
+    run("unaligned 4096-byte writes", wbuf + 1, rbuf + 1, PAGE);
+    run("512-byte writes", wbuf, rbuf, 512);
+
+    exit();
+}
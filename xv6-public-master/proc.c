@@ -6,19 +6,63 @@
 #include "x86.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "lathist.h"
+#include "pstat.h"
+#include "trace.h"
 
 struct {
   struct spinlock lock;
   struct proc proc[NPROC];
+  struct proc *pidhash[NPROC]; // pid -> proc chains, see get_proc_by_pid
 } ptable;
 
+#define PIDHASH(pid) ((uint)(pid) % NPROC)
+
+// Per-CPU run queues, one per scheduling level: RR and FCFS
+// are linked lists, SJF is a binary min-heap on burst_time.
+// A process is on exactly one queue while it is RUNNABLE
+// and has not yet been picked by a scheduler. Processes are added
+// with ptable.lock held; a scheduler picks from its own queue
+// holding only that queue's lock.
+struct runqueue {
+  struct spinlock lock;
+  struct proc *head[NLEVEL];
+  struct proc *tail[NLEVEL];
+  struct proc *heap[NPROC];    // SJF level, count[SJF] entries
+  int count[NLEVEL];
+  int nrunnable;
+} runqueues[NCPU];
+
+// Aging timer wheel. A process queued at the SJF or FCFS level
+// sits in the bucket of the tick on which it starts to starve,
+// so aging() only visits the processes due on the current tick.
+// Lock order: ptable.lock, then a run queue lock, then agewheel.lock.
+struct {
+  struct spinlock lock;
+  struct proc *bucket[AGING_WHEEL];
+  uint last;                   // Last tick aging() has handled
+} agewheel;
+
+// Staging area for getprocstats(), so that the snapshot
+// can be taken under ptable.lock and copied out in one go.
+struct {
+  struct spinlock lock;
+  struct pstat stat[NPROC];
+} pstats;
+
 static struct proc *initproc;
 
+#ifndef SJFBENCH
+#define SJFBENCH 0  // see the Makefile
+#endif
+
 int nextpid = 1;
 extern void forkret(void);
 extern void trapret(void);
 
 static void wakeup1(void *chan);
+static void pid_hash(struct proc *p);
+static void pid_unhash(struct proc *p);
 
 struct reentrantlock rlock;
 
@@ -26,6 +70,10 @@ void
 pinit(void)
 {
   initlock(&ptable.lock, "ptable");
+  for(int i = 0; i < NCPU; i++)
+    initlock(&runqueues[i].lock, "runqueue");
+  initlock(&agewheel.lock, "agewheel");
+  initlock(&pstats.lock, "pstats");
 }
 
 // Must be called with interrupts disabled
@@ -92,6 +140,11 @@ allocproc(void)
 found:
   p->state = EMBRYO;
   p->pid = nextpid++;
+  pid_hash(p);
+  p->rqcpu = -1;
+  p->lastcpu = -1;
+  p->agebucket = -1;
+  p->kfn = 0;
 
   for(int i = 0; i < MAX_SYSCALLS; i++){
     p->used_syscalls[i] = 0;
@@ -101,9 +154,25 @@ found:
 
   // Allocate kernel stack.
   if((p->kstack = kalloc()) == 0){
+    acquire(&ptable.lock);
+    pid_unhash(p);
     p->state = UNUSED;
+    release(&ptable.lock);
     return 0;
   }
+
+  // Syscall latency histogram, filled in by syscall().
+  if((p->lathist = (struct lathist*)kalloc()) == 0){
+    kfree(p->kstack);
+    p->kstack = 0;
+    acquire(&ptable.lock);
+    pid_unhash(p);
+    p->state = UNUSED;
+    release(&ptable.lock);
+    return 0;
+  }
+  memset(p->lathist, 0, sizeof(*p->lathist));
+
   sp = p->kstack + KSTACKSIZE;
 
   // Leave room for trap frame.
@@ -161,6 +230,7 @@ userinit(void)
   acquire(&ptable.lock);
 
   p->state = RUNNABLE;
+  rq_add(p);
   int pid = p->pid;
 
   release(&ptable.lock);
@@ -168,21 +238,70 @@ userinit(void)
   change_queue(pid, RR);
 }
 
+// First code a kernel process runs, from the scheduler.
+static void
+kprocstart(void)
+{
+  // Still holding ptable.lock from scheduler.
+  release(&ptable.lock);
+  myproc()->kfn();
+  panic("kproc returned");
+}
+
+// Start a kernel process that runs fn, which must never
+// return. It has no user memory and is scheduled like any
+// other process.
+void
+kproc(char *name, void (*fn)(void))
+{
+  struct proc *p;
+  int pid;
+
+  if((p = allocproc()) == 0)
+    panic("kproc");
+  if((p->pgdir = setupkvm()) == 0)
+    panic("kproc: out of memory?");
+  p->sz = 0;
+  p->parent = initproc;
+  p->kfn = fn;
+  p->context->eip = (uint)kprocstart;
+  safestrcpy(p->name, name, sizeof(p->name));
+
+  acquire(&ptable.lock);
+  p->state = RUNNABLE;
+  rq_add(p);
+  pid = p->pid;
+  release(&ptable.lock);
+
+  change_queue(pid, RR);
+}
+
 // Grow current process's memory by n bytes.
+// Growing only moves sz; uvmfault() maps zeroed pages
+// when the new memory is first touched.
 // Return 0 on success, -1 on failure.
 int
 growproc(int n)
 {
   uint sz;
+  struct segment *s;
   struct proc* curproc = myproc();
 
   sz = curproc->sz;
   if(n > 0){
-    if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
+    if(sz + n < sz || sz + n >= SHMBASE)
       return -1;
+    sz += n;
   } else if(n < 0){
     if((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
       return -1;
+    // Memory given back comes back zeroed, not reread from the file.
+    for(s = curproc->seg; s < &curproc->seg[curproc->nseg]; s++){
+      if(s->va >= PGROUNDUP(sz))
+        s->filesz = 0;
+      else if(s->va + s->filesz > PGROUNDUP(sz))
+        s->filesz = PGROUNDUP(sz) - s->va;
+    }
   }
   curproc->sz = sz;
   switchuvm(curproc);
@@ -205,10 +324,19 @@ fork(void)
   }
 
   // Copy process state from proc.
-  if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
+  if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0 ||
+     fork_sharedmem(curproc, np) < 0){
+    if(np->pgdir)
+      freevm(np->pgdir);
+    np->pgdir = 0;
     kfree(np->kstack);
     np->kstack = 0;
+    kfree((char*)np->lathist);
+    np->lathist = 0;
+    acquire(&ptable.lock);
+    pid_unhash(np);
     np->state = UNUSED;
+    release(&ptable.lock);
     return -1;
   }
   np->sz = curproc->sz;
@@ -223,6 +351,11 @@ fork(void)
       np->ofile[i] = filedup(curproc->ofile[i]);
   np->cwd = idup(curproc->cwd);
 
+  if(curproc->exeip)
+    np->exeip = idup(curproc->exeip);
+  memmove(np->seg, curproc->seg, sizeof(curproc->seg));
+  np->nseg = curproc->nseg;
+
   safestrcpy(np->name, curproc->name, sizeof(curproc->name));
 
   pid = np->pid;
@@ -230,10 +363,14 @@ fork(void)
   acquire(&ptable.lock);
 
   np->state = RUNNABLE;
+  rq_add(np);
 
   release(&ptable.lock);
 
-  if(pid == 2)
+  // init's children are the shells; give them the RR queue.
+  // (Their pid varies now that kernel processes such as logd
+  // are started first.)
+  if(curproc == initproc)
     change_queue(pid, RR);
 
   return pid;
@@ -260,10 +397,16 @@ exit(void)
     }
   }
 
+  exit_sharedmem(curproc);
+
   begin_op();
   iput(curproc->cwd);
+  if(curproc->exeip)
+    iput(curproc->exeip);
   end_op();
   curproc->cwd = 0;
+  curproc->exeip = 0;
+  curproc->nseg = 0;
 
   acquire(&ptable.lock);
 
@@ -307,7 +450,10 @@ wait(void)
         pid = p->pid;
         kfree(p->kstack);
         p->kstack = 0;
+        kfree((char*)p->lathist);
+        p->lathist = 0;
         freevm(p->pgdir);
+        pid_unhash(p);
         p->pid = 0;
         p->parent = 0;
         p->name[0] = 0;
@@ -342,30 +488,33 @@ void
 scheduler(void)
 {
   struct proc* p;
-  struct proc* last_executed_proc = &ptable.proc[NPROC - 1];
   struct cpu* c = mycpu();
+  int self = cpuid();
+  struct runqueue* rq = &runqueues[self];
   c->proc = 0;
   
   for(;;) {
     // Enable interrupts on this processor.
     sti();
 
-    // Loop over process table looking for process to run.
-    acquire(&ptable.lock);
-
-    if(mycpu()->RR_remain_time > 0) {
-      p = round_robin(last_executed_proc);
+    // Pick from this CPU's run queues; when a level is empty
+    // here, steal from the busiest CPU at that same level so the
+    // level weights still hold. ptable.lock is taken just for
+    // the switch itself.
+    if(c->RR_remain_time > 0) {
+      if((p = round_robin(rq)) == 0)
+        p = steal_process(self, RR);
 
       if(p != 0) {
-        last_executed_proc = p;
         run_process_on_cpu(p, c);
 
         continue;
       }
     }
 
-    if(mycpu()->SJF_remain_time > 0) {
-      p = shortest_job_first();
+    if(c->SJF_remain_time > 0) {
+      if((p = shortest_job_first(rq)) == 0)
+        p = steal_process(self, SJF);
 
       if(p != 0) {
         run_process_on_cpu(p, c);
@@ -374,8 +523,9 @@ scheduler(void)
       }
     }
 
-    if(mycpu()->FCFS_remain_time > 0) {
-      p = first_come_first_service();
+    if(c->FCFS_remain_time > 0) {
+      if((p = first_come_first_service(rq)) == 0)
+        p = steal_process(self, FCFS);
 
       if(p != 0) {
         run_process_on_cpu(p, c);
@@ -384,12 +534,9 @@ scheduler(void)
       }
     }
 
-    mycpu()->RR_remain_time = RR_WEIGHT * TIME_SLICE_UNIT / SYS_TICK;
-    mycpu()->SJF_remain_time = SJF_WEIGHT * TIME_SLICE_UNIT / SYS_TICK;
-    mycpu()->FCFS_remain_time = FCFS_WEIGHT * TIME_SLICE_UNIT / SYS_TICK;
-
-    release(&ptable.lock);
-
+    c->RR_remain_time = RR_WEIGHT * TIME_SLICE_UNIT / SYS_TICK;
+    c->SJF_remain_time = SJF_WEIGHT * TIME_SLICE_UNIT / SYS_TICK;
+    c->FCFS_remain_time = FCFS_WEIGHT * TIME_SLICE_UNIT / SYS_TICK;
   }
 }
 
@@ -418,6 +565,7 @@ yield(void)
 {
   acquire(&ptable.lock);  //DOC: yieldlock
   myproc()->state = RUNNABLE;
+  rq_add(myproc());
   sched();
   release(&ptable.lock);
 }
@@ -469,6 +617,7 @@ sleep(void* chan, struct spinlock* lk)
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  trace(TRACE_SLEEP, p->pid, (int)chan);
 
   sched();
 
@@ -491,8 +640,11 @@ wakeup1(void* chan)
   struct proc* p;
 
   for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == SLEEPING && p->chan == chan)
+    if(p->state == SLEEPING && p->chan == chan){
       p->state = RUNNABLE;
+      trace(TRACE_WAKEUP, p->pid, (int)chan);
+      rq_add(p);
+    }
 }
 
 // Wake up all processes sleeping on chan.
@@ -513,15 +665,15 @@ kill(int pid)
   struct proc* p;
 
   acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->pid == pid){
-      p->killed = 1;
-      // Wake process from sleep if necessary.
-      if(p->state == SLEEPING)
-        p->state = RUNNABLE;
-      release(&ptable.lock);
-      return 0;
+  if((p = get_proc_by_pid(pid)) != 0){
+    p->killed = 1;
+    // Wake process from sleep if necessary.
+    if(p->state == SLEEPING){
+      p->state = RUNNABLE;
+      rq_add(p);
     }
+    release(&ptable.lock);
+    return 0;
   }
   release(&ptable.lock);
   return -1;
@@ -564,31 +716,54 @@ procdump(void)
   }
 }
 
+// Add p to the pid hash. Caller holds ptable.lock.
+static void
+pid_hash(struct proc* p)
+{
+  struct proc** head = &ptable.pidhash[PIDHASH(p->pid)];
+
+  p->pidnext = *head;
+  *head = p;
+}
+
+// Remove p from the pid hash. Caller holds ptable.lock.
+static void
+pid_unhash(struct proc* p)
+{
+  struct proc** pp;
+
+  for(pp = &ptable.pidhash[PIDHASH(p->pid)]; *pp != 0; pp = &(*pp)->pidnext) {
+    if(*pp == p) {
+      *pp = p->pidnext;
+      p->pidnext = 0;
+      return;
+    }
+  }
+}
+
+// Look up a live process by pid through the pid hash.
+// Caller must hold ptable.lock, and the returned proc is only
+// valid until the caller releases it.
 struct proc*
 get_proc_by_pid(int pid)
 { 
     struct proc* p;
 
-    acquire(&ptable.lock);
-    for (p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
-        if (p->pid == pid) {
-            release(&ptable.lock);
+    if(!holding(&ptable.lock))
+      panic("get_proc_by_pid");
+
+    for (p = ptable.pidhash[PIDHASH(pid)]; p != 0; p = p->pidnext) {
+        if (p->pid == pid)
             return p;
-        }
     }
-    release(&ptable.lock);
 
     return 0;  // Return 0 if the process with the given PID was not found
 }
 
-int
-get_total_syscalls(int pid)
+static int
+total_syscalls(struct proc* p)
 {
-  struct proc* p = get_proc_by_pid(pid);
   int num_of_syscalls = 0;
-  
-  if(p == 0)
-    return -1;
 
   for(int i = 0; i < MAX_SYSCALLS; i++){
     num_of_syscalls += p->used_syscalls[i];
@@ -597,6 +772,20 @@ get_total_syscalls(int pid)
   return num_of_syscalls;
 }
 
+int
+get_total_syscalls(int pid)
+{
+  struct proc* p;
+  int num_of_syscalls = -1;
+
+  acquire(&ptable.lock);
+  if((p = get_proc_by_pid(pid)) != 0)
+    num_of_syscalls = total_syscalls(p);
+  release(&ptable.lock);
+
+  return num_of_syscalls;
+}
+
 
 int
 create_palindrome(int num)
@@ -635,13 +824,21 @@ create_palindrome(int num)
 int
 sort_syscalls(int pid)
 {
-  struct proc* p = get_proc_by_pid(pid);
+  struct proc* p;
+  int used_syscalls[MAX_SYSCALLS];
 
-  if(p == 0)
+  // Copy the counts out so that the console is not
+  // used while holding ptable.lock.
+  acquire(&ptable.lock);
+  if((p = get_proc_by_pid(pid)) == 0){
+    release(&ptable.lock);
     return -1;
+  }
+  memmove(used_syscalls, p->used_syscalls, sizeof(used_syscalls));
+  release(&ptable.lock);
 
   for(int i = 0; i < MAX_SYSCALLS; i++){
-    cprintf("\tSystem call number %d: %d usage\n", i + 1, p->used_syscalls[i]);
+    cprintf("\tSystem call number %d: %d usage\n", i + 1, used_syscalls[i]);
   }
 
   return 0;
@@ -651,10 +848,13 @@ int
 get_most_invoked_syscall(int pid)
 {
   int max_count = 0, index_max = 0;
-  struct proc *p = get_proc_by_pid(pid);
+  struct proc *p;
 
-  if(p == 0)
+  acquire(&ptable.lock);
+  if((p = get_proc_by_pid(pid)) == 0){
+    release(&ptable.lock);
     return -1;
+  }
 
   for(int i = 0; i < MAX_SYSCALLS; i++){
     if(p->used_syscalls[i] > max_count){
@@ -662,6 +862,7 @@ get_most_invoked_syscall(int pid)
       index_max = i;
     }
   }
+  release(&ptable.lock);
 
   cprintf("The most invoked system call is system call number %d with %d usage\n", index_max + 1, max_count);
 
@@ -675,7 +876,7 @@ list_all_processes(void)
 
   for (struct proc *p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
     if (p->state != UNUSED) {  // Check if the process is active
-      cprintf("Process with id %d and name %s has totally %d system calls\n", p->pid, p->name, get_total_syscalls(p->pid));
+      cprintf("Process with id %d and name %s has totally %d system calls\n", p->pid, p->name, total_syscalls(p));
       flag = 1;
     }
   }
@@ -692,93 +893,543 @@ create_random_number(int seed)
   return ticks % seed;
 }
 
-struct proc*
-round_robin(struct proc* last_executed_proc)
+// First tick at which aging() would promote p, matching
+// the STARVATION_BOUNDRY test on both time stamps.
+static uint
+starvation_deadline(struct proc* p)
 {
-  int count = 0;
+  uint since = p->ti.enter_queue_time;
+
+  if(p->ti.last_run_time > since)
+    since = p->ti.last_run_time;
+
+  return since + STARVATION_BOUNDRY + 1;
+}
+
+// Put p in the wheel bucket of its starvation deadline.
+// Deadlines already passed go to the next tick to be handled.
+static void
+aging_insert(struct proc* p)
+{
+  uint deadline = starvation_deadline(p);
+  int b;
+
+  acquire(&agewheel.lock);
+
+  if(p->agebucket >= 0)
+    panic("aging_insert");
+
+  if(deadline <= agewheel.last)
+    deadline = agewheel.last + 1;
 
-  for(struct proc* p = last_executed_proc; count < sizeof(ptable.proc); p++, count++) {
-    if(p >= &ptable.proc[NPROC])
-      p = ptable.proc;
+  b = deadline % AGING_WHEEL;
+  p->ageprev = 0;
+  p->agenext = agewheel.bucket[b];
+  if(p->agenext)
+    p->agenext->ageprev = p;
+  agewheel.bucket[b] = p;
+  p->agebucket = b;
 
-    if((p->state == RUNNABLE) && (p->ti.queue == RR))
-      return p;
+  release(&agewheel.lock);
+}
+
+// Take p out of the wheel if aging() has not already done so.
+static void
+aging_remove(struct proc* p)
+{
+  acquire(&agewheel.lock);
+
+  if(p->agebucket >= 0) {
+    if(p->ageprev)
+      p->ageprev->agenext = p->agenext;
+    else
+      agewheel.bucket[p->agebucket] = p->agenext;
+    if(p->agenext)
+      p->agenext->ageprev = p->ageprev;
+    p->agenext = p->ageprev = 0;
+    p->agebucket = -1;
   }
 
-  return 0;
+  release(&agewheel.lock);
 }
 
-struct proc*
-shortest_job_first()
+static void
+heap_set(struct runqueue* rq, int i, struct proc* p)
 {
-  struct proc* shortest_time_proc = 0;
+  rq->heap[i] = p;
+  p->heapidx = i;
+}
 
-  for(struct proc* p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-  {
-    if((p->state != RUNNABLE) || (p->ti.queue != SJF))
-      continue;
+// Move the entry at i toward the root until its parent
+// has a burst time no longer than its own.
+static void
+heap_up(struct runqueue* rq, int i)
+{
+  struct proc* p = rq->heap[i];
+  int parent;
+
+  while(i > 0) {
+    parent = (i - 1) / 2;
+    if(rq->heap[parent]->ti.burst_time <= p->ti.burst_time)
+      break;
+    heap_set(rq, i, rq->heap[parent]);
+    i = parent;
+  }
+  heap_set(rq, i, p);
+}
 
-    if(shortest_time_proc == 0)
-      shortest_time_proc = p;
+// Move the entry at i toward the leaves until both children
+// have burst times no shorter than its own.
+static void
+heap_down(struct runqueue* rq, int i)
+{
+  struct proc* p = rq->heap[i];
+  int n = rq->count[SJF];
+  int child;
+
+  while((child = 2 * i + 1) < n) {
+    if(child + 1 < n &&
+       rq->heap[child + 1]->ti.burst_time < rq->heap[child]->ti.burst_time)
+      child++;
+    if(p->ti.burst_time <= rq->heap[child]->ti.burst_time)
+      break;
+    heap_set(rq, i, rq->heap[child]);
+    i = child;
+  }
+  heap_set(rq, i, p);
+}
 
-    if(p->ti.burst_time < shortest_time_proc->ti.burst_time)
-      if(p->ti.confidence > create_random_number(100))
-        shortest_time_proc = p;
+// Link p at the right place in its level's queue of rq.
+// Caller holds rq->lock.
+static void
+rq_link(struct runqueue* rq, struct proc* p)
+{
+  int level = p->ti.queue;
+  struct proc* next = 0;
+
+  if(level != RR)
+    aging_insert(p);
+
+  if(level == SJF) {
+    heap_set(rq, rq->count[SJF], p);
+    heap_up(rq, rq->count[SJF]++);
+    rq->nrunnable++;
+    return;
   }
 
-  return shortest_time_proc;
+  // FCFS keeps its list sorted by queue entry time so the
+  // earliest arrival is always at the head.
+  if(level == FCFS)
+    for(next = rq->head[level]; next != 0; next = next->rqnext)
+      if(next->ti.enter_queue_time > p->ti.enter_queue_time)
+        break;
+
+  p->rqnext = next;
+  p->rqprev = next ? next->rqprev : rq->tail[level];
+  if(p->rqprev)
+    p->rqprev->rqnext = p;
+  else
+    rq->head[level] = p;
+  if(next)
+    next->rqprev = p;
+  else
+    rq->tail[level] = p;
+
+  rq->count[level]++;
+  rq->nrunnable++;
+}
+
+// Unlink p from its level's queue of rq.
+// Caller holds rq->lock.
+static void
+rq_unlink(struct runqueue* rq, struct proc* p)
+{
+  int level = p->ti.queue;
+  struct proc* last;
+
+  aging_remove(p);
+
+  if(level == SJF) {
+    // Fill the hole with the last entry and restore the heap.
+    last = rq->heap[--rq->count[SJF]];
+    if(last != p) {
+      heap_set(rq, p->heapidx, last);
+      heap_up(rq, last->heapidx);
+      heap_down(rq, last->heapidx);
+    }
+    p->rqcpu = -1;
+    rq->nrunnable--;
+    return;
+  }
+
+  if(p->rqprev)
+    p->rqprev->rqnext = p->rqnext;
+  else
+    rq->head[level] = p->rqnext;
+  if(p->rqnext)
+    p->rqnext->rqprev = p->rqprev;
+  else
+    rq->tail[level] = p->rqprev;
+
+  p->rqnext = p->rqprev = 0;
+  p->rqcpu = -1;
+  rq->count[level]--;
+  rq->nrunnable--;
+}
+
+// Put p on the run queue of the given CPU.
+// Caller holds ptable.lock and p is RUNNABLE.
+static void
+rq_push(int cpu, struct proc* p)
+{
+  struct runqueue* rq = &runqueues[cpu];
+
+  if(p->rqcpu >= 0)
+    panic("rq_push queued");
+
+  acquire(&rq->lock);
+  rq_link(rq, p);
+  p->rqcpu = cpu;
+  release(&rq->lock);
+}
+
+// Take p off whatever run queue it is on, if any.
+// Returns the CPU it was queued on, or -1.
+// Caller holds ptable.lock.
+static int
+rq_remove(struct proc* p)
+{
+  int cpu = p->rqcpu;
+  struct runqueue* rq;
+
+  if(cpu < 0)
+    return -1;
+
+  rq = &runqueues[cpu];
+  acquire(&rq->lock);
+  // A scheduler may have picked p before we got the lock.
+  if(p->rqcpu != cpu) {
+    release(&rq->lock);
+    return -1;
+  }
+  rq_unlink(rq, p);
+  release(&rq->lock);
+
+  return cpu;
+}
+
+// Make a RUNNABLE process visible to the schedulers.
+// It goes back to the CPU it last ran on to keep its cache
+// warm; a process that never ran goes to the least loaded CPU.
+// Caller holds ptable.lock.
+void
+rq_add(struct proc* p)
+{
+  int cpu = p->lastcpu;
+
+  if(cpu < 0){
+    cpu = 0;
+    for(int i = 1; i < ncpu; i++)
+      if(runqueues[i].nrunnable < runqueues[cpu].nrunnable)
+        cpu = i;
+  }
+
+  rq_push(cpu, p);
+}
+
+// Move p to the target level, requeueing it if it is queued.
+// Caller holds ptable.lock.
+static void
+set_queue(struct proc* p, int target_queue)
+{
+  int cpu = rq_remove(p);
+
+  p->ti.queue = target_queue;
+  p->ti.enter_queue_time = ticks;
+
+  if(cpu >= 0)
+    rq_push(cpu, p);
 }
 
 struct proc*
-first_come_first_service()
+round_robin(struct runqueue* rq)
 {
-  struct proc* earliest_entered_time_proc = 0;
+  struct proc* p;
 
-  for(struct proc* p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-  {
-    if((p->state != RUNNABLE) || (p->ti.queue != FCFS))
-      continue;
+  // New and preempted processes are appended at the tail,
+  // so taking the head visits them in turn.
+  acquire(&rq->lock);
+  if((p = rq->head[RR]) != 0)
+    rq_unlink(rq, p);
+  release(&rq->lock);
 
-    if(earliest_entered_time_proc == 0)
-      earliest_entered_time_proc = p;
+  return p;
+}
 
-    if(p->ti.enter_queue_time < earliest_entered_time_proc->ti.enter_queue_time)
-      earliest_entered_time_proc = p;
+// Built with SJFBENCH=1 (the heap) or SJFBENCH=2 (the linear
+// scan the heap replaced), each pick is timed and traced as
+// TRACE_SJF_PICK, so sjf_test can compare the two.
+struct proc*
+shortest_job_first(struct runqueue* rq)
+{
+  struct proc* shortest_time_proc = 0;
+#if SJFBENCH
+  uint64 start = rdtsc();
+#endif
+
+  acquire(&rq->lock);
+
+#if SJFBENCH == 2
+  if(rq->count[SJF] > 0) {
+    shortest_time_proc = rq->heap[rq->count[SJF] - 1];
+
+    for(int i = rq->count[SJF] - 1; i >= 0; i--) {
+      struct proc* p = rq->heap[i];
+      if(p->ti.burst_time < shortest_time_proc->ti.burst_time)
+        if(p->ti.confidence > create_random_number(100))
+          shortest_time_proc = p;
+    }
+
+    rq_unlink(rq, shortest_time_proc);
   }
+#else
+  if(rq->count[SJF] > 0) {
+    shortest_time_proc = rq->heap[0];
+
+    // One lottery per decision: the shortest job runs with
+    // probability equal to its confidence, otherwise the
+    // runner-up (the shorter child of the root) runs instead.
+    if(rq->count[SJF] > 1 &&
+       shortest_time_proc->ti.confidence <= create_random_number(100)) {
+      shortest_time_proc = rq->heap[1];
+      if(rq->count[SJF] > 2 &&
+         rq->heap[2]->ti.burst_time < shortest_time_proc->ti.burst_time)
+        shortest_time_proc = rq->heap[2];
+    }
+
+    rq_unlink(rq, shortest_time_proc);
+  }
+#endif
+
+  release(&rq->lock);
+
+#if SJFBENCH
+  if(shortest_time_proc)
+    trace(TRACE_SJF_PICK, shortest_time_proc->pid, rdtsc() - start);
+#endif
+
+  return shortest_time_proc;
+}
+
+struct proc*
+first_come_first_service(struct runqueue* rq)
+{
+  struct proc* earliest_entered_time_proc;
+
+  // The FCFS list is kept sorted by enter_queue_time.
+  acquire(&rq->lock);
+  if((earliest_entered_time_proc = rq->head[FCFS]) != 0)
+    rq_unlink(rq, earliest_entered_time_proc);
+  release(&rq->lock);
 
   return earliest_entered_time_proc;
 }
 
+// Called on every CPU-0 timer tick. Promotes the processes
+// whose starvation deadline is this tick: SJF to RR, FCFS to SJF.
+// Processes are taken from the wheel in small batches so that
+// ptable.lock is never taken under agewheel.lock.
 void
 aging()
 {
-  acquire(&ptable.lock);
+  struct proc* due[8];
+  int pids[8];
+  int n, b;
+
+  acquire(&agewheel.lock);
+  agewheel.last = ticks;
+  b = agewheel.last % AGING_WHEEL;
+  release(&agewheel.lock);
+
+  do {
+    acquire(&agewheel.lock);
+    for(n = 0; n < NELEM(due) && agewheel.bucket[b] != 0; n++) {
+      due[n] = agewheel.bucket[b];
+      pids[n] = due[n]->pid;
+      agewheel.bucket[b] = due[n]->agenext;
+      if(agewheel.bucket[b])
+        agewheel.bucket[b]->ageprev = 0;
+      due[n]->agenext = due[n]->ageprev = 0;
+      due[n]->agebucket = -1;
+    }
+    release(&agewheel.lock);
 
-  for (struct proc* p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
-    if (p->state != RUNNABLE || p->ti.queue == RR)
-      continue;
+    // Most ticks have nothing due; don't touch ptable.lock then.
+    if(n == 0)
+      return;
 
-    if ((ticks - p->ti.last_run_time > STARVATION_BOUNDRY) && (ticks - p->ti.enter_queue_time > STARVATION_BOUNDRY)) {
-        release(&ptable.lock);
+    acquire(&ptable.lock);
 
+    for(int i = 0; i < n; i++) {
+      struct proc* p = due[i];
+
+      // p may have been picked, exited or reused meanwhile.
+      if(p->pid != pids[i] || p->state != RUNNABLE || p->ti.queue == RR)
+        continue;
+
+      if ((ticks - p->ti.last_run_time > STARVATION_BOUNDRY) && (ticks - p->ti.enter_queue_time > STARVATION_BOUNDRY)) {
         if(p->ti.queue == SJF)
-          change_queue(p->pid, RR);
+          set_queue(p, RR);
         else if(p->ti.queue == FCFS)
-          change_queue(p->pid, SJF);
+          set_queue(p, SJF);
+        trace(TRACE_AGING, p->pid, p->ti.queue);
 
         //cprintf("pid: %d starved!\n", p->pid);
+      } else {
+        // Not due after all; requeueing puts it back in the wheel.
+        int cpu = rq_remove(p);
+        if(cpu >= 0)
+          rq_push(cpu, p);
+      }
+    }
+
+    release(&ptable.lock);
+  } while(n == NELEM(due));
+}
+
+// Copy the syscall latency histogram of process pid to h.
+int
+get_proc_latency(int pid, struct lathist* h)
+{
+  struct proc* p;
 
-        acquire(&ptable.lock);
-    }  
+  acquire(&ptable.lock);
+  if((p = get_proc_by_pid(pid)) == 0){
+    release(&ptable.lock);
+    return -1;
+  }
+  memmove(h, p->lathist, sizeof(*h));
+  release(&ptable.lock);
+
+  return 0;
+}
+
+// Copy a snapshot of at most n live processes to the
+// struct pstat array at user address addr. The whole table is
+// read under one hold of ptable.lock, so the entries are
+// consistent with each other. Returns the number copied.
+int
+getprocstats(uint addr, int n)
+{
+  struct proc* p;
+  struct pstat* ps;
+  int count = 0;
+
+  if(n < 0)
+    return -1;
+  if(n > NPROC)
+    n = NPROC;
+
+  acquire(&pstats.lock);
+  acquire(&ptable.lock);
+
+  for(p = ptable.proc; p < &ptable.proc[NPROC] && count < n; p++) {
+    if(p->state == UNUSED)
+      continue;
+
+    ps = &pstats.stat[count++];
+    ps->pid = p->pid;
+    ps->ppid = p->parent ? p->parent->pid : 0;
+    ps->state = p->state;
+    ps->sz = p->sz;
+    ps->killed = p->killed;
+    ps->lastcpu = p->lastcpu;
+    memmove(ps->name, p->name, sizeof(ps->name));
+    ps->queue = p->ti.queue;
+    ps->ticks_used = p->ti.ticks_used;
+    ps->burst_time = p->ti.burst_time;
+    ps->creation_time = p->ti.creation_time;
+    ps->enter_queue_time = p->ti.enter_queue_time;
+    ps->last_run_time = p->ti.last_run_time;
+    ps->confidence = p->ti.confidence;
+    memmove(ps->used_syscalls, p->used_syscalls, sizeof(ps->used_syscalls));
   }
 
   release(&ptable.lock);
+
+  if(copyout(myproc()->pgdir, addr, pstats.stat, count * sizeof(struct pstat)) < 0)
+    count = -1;
+
+  release(&pstats.lock);
+
+  return count;
 }
 
+// Take a RUNNABLE process of the given level from the CPU
+// with the most queued work at that level, using that level's
+// own selection policy. Called by the scheduler of CPU self
+// when its own queue for that level is empty.
+struct proc*
+steal_process(int self, int level)
+{
+  struct runqueue* victim = 0;
+  struct proc* p = 0;
+
+  // Unlocked peek; the pick below rechecks under the lock.
+  for(int i = 0; i < ncpu; i++) {
+    if(i == self || runqueues[i].count[level] == 0)
+      continue;
+    if(victim == 0 || runqueues[i].count[level] > victim->count[level])
+      victim = &runqueues[i];
+  }
+
+  if(victim == 0)
+    return 0;
+
+  if(level == RR)
+    p = round_robin(victim);
+  else if(level == SJF)
+    p = shortest_job_first(victim);
+  else if(level == FCFS)
+    p = first_come_first_service(victim);
+
+  if(p != 0)
+    cpus[self].steals++;
+
+  return p;
+}
+
+int
+get_steal_count(int cpu)
+{
+  int count = 0;
+
+  if(cpu >= ncpu)
+    return -1;
+
+  if(cpu >= 0)
+    return cpus[cpu].steals;
+
+  for(int i = 0; i < ncpu; i++)
+    count += cpus[i].steals;
+
+  return count;
+}
+
+// Switch to p, which the caller has just taken off a run queue.
+// The previous owner of p may still be inside sched() on another
+// CPU; acquiring ptable.lock waits until its context is saved.
 void
 run_process_on_cpu(struct proc* p, struct cpu* c)
 {
+    acquire(&ptable.lock);
+
+    if(p->state != RUNNABLE)
+      panic("run_process_on_cpu");
+
     c->proc = p;
+    p->lastcpu = cpuid();
+    trace(TRACE_SWITCH_IN, p->pid, p->ti.queue);
 
     switchuvm(p);
 
@@ -788,6 +1439,7 @@ run_process_on_cpu(struct proc* p, struct cpu* c)
     swtch(&(c->scheduler), p->context);
 
     switchkvm();
+    trace(TRACE_SWITCH_OUT, p->pid, p->state);
     
     c->proc = 0;
 
@@ -797,12 +1449,28 @@ run_process_on_cpu(struct proc* p, struct cpu* c)
 int
 set_initial_burst_confidence(int pid, int burst, int confidence)
 {
-  struct proc* p = get_proc_by_pid(pid);
+  struct proc* p;
+  int cpu;
+
+  acquire(&ptable.lock);
+
+  if((p = get_proc_by_pid(pid)) == 0){
+    release(&ptable.lock);
+    return -1;
+  }
+
+  // The SJF heap is keyed on burst_time, so requeue around the update.
+  cpu = rq_remove(p);
 
   p->ti.burst_time = burst;
   p->ti.confidence = confidence;
 
-  cprintf("pid: %d new_burst: %d new_confidence: %d\n", pid, p->ti.burst_time, p->ti.confidence);
+  if(cpu >= 0)
+    rq_push(cpu, p);
+
+  release(&ptable.lock);
+
+  cprintf("pid: %d new_burst: %d new_confidence: %d\n", pid, burst, confidence);
 
   return 0;
 }
@@ -810,13 +1478,18 @@ set_initial_burst_confidence(int pid, int burst, int confidence)
 int
 change_queue(int pid, int target_queue)
 {
-  struct proc *p = get_proc_by_pid(pid);
-
-  acquire(&ptable.lock);
+  struct proc *p;
 
-  p->ti.queue = target_queue;
-  p->ti.enter_queue_time = ticks;
+  if(target_queue < RR || target_queue > FCFS)
+    return -1;
 
+  acquire(&ptable.lock);
+  if((p = get_proc_by_pid(pid)) == 0){
+    release(&ptable.lock);
+    return -1;
+  }
+  set_queue(p, target_queue);
+  trace(TRACE_QUEUE, pid, target_queue);
   release(&ptable.lock);
 
   return 0;
@@ -861,20 +1534,23 @@ print_process_information()
   return 0;
 }
 
+// Print the per-CPU counters and their sum. There is no separate
+// global counter any more: every call lands in exactly one CPU's
+// slot, so the global total is the sum.
 int
 get_number_of_total_syscalls()
 {
-  int count = 0;
+  int count = 0, n;
   for(int i = 0; i < NCPU; i++) {
-    if(cpus[i].number_of_syscalls != 0) {
-      count += cpus[i].number_of_syscalls;
-      cprintf("number of syscalls for cpu {%d} is : %d\n", i, cpus[i].number_of_syscalls);
+    if((n = get_cpu_syscalls(i)) != 0) {
+      count += n;
+      cprintf("number of syscalls for cpu {%d} is : %d\n", i, n);
     }
   }
 
   cprintf("number of total syscalls for all cpus is (sum of cpus): %d\n", count);
 
-  cprintf("number of total syscalls for all cpus is (global) : %d\n", total_number_of_syscalls);
+  cprintf("number of total syscalls for all cpus is (global) : %d\n", count);
 
   return 0;
 }
@@ -11,7 +11,7 @@ struct cpu {
   int RR_remain_time;
   int SJF_remain_time;
   int FCFS_remain_time;
-  int number_of_syscalls;
+  int steals;                  // Processes taken from other CPUs' run queues
 };
 
 extern struct cpu cpus[NCPU];
@@ -38,8 +38,8 @@ struct context {
 
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 enum levels { RR, SJF, FCFS };
+#define NLEVEL 3         // Number of scheduling levels in enum levels
 
-#define MAX_SYSCALLS 26  // Define a reasonable maximum for tracked system calls.
 
 struct timeInfo {
   enum levels queue;
@@ -52,6 +52,16 @@ struct timeInfo {
 };
 
 // Per-process state
+// Part of the executable that exec() left unmapped, to be
+// read in by uvmfault() when a page of it is first touched.
+struct segment {
+  uint va;                     // Page-aligned start in user memory
+  uint off;                    // Offset of the contents in the file
+  uint filesz;                 // Bytes backed by the file; the rest is zero
+};
+
+struct shmseg;
+
 struct proc {
   uint sz;                     // Size of process memory (bytes)
   pde_t* pgdir;                // Page table
@@ -68,10 +78,27 @@ struct proc {
   char name[16];               // Process name (debugging)
   int used_syscalls[MAX_SYSCALLS];
   struct timeInfo ti;
+  struct lathist *lathist;     // Syscall latency histogram page
+  struct proc *rqnext;         // Next process on the same run queue level
+  struct proc *rqprev;         // Previous process on the same run queue level
+  int heapidx;                 // Slot in the SJF heap while queued there
+  struct proc *pidnext;        // Next process in the same pid hash chain
+  int rqcpu;                   // Run queue holding this process, or -1
+  struct proc *agenext;        // Next process in the same aging bucket
+  struct proc *ageprev;        // Previous process in the same aging bucket
+  int agebucket;               // Aging wheel bucket, or -1
+  int lastcpu;                 // CPU this process last ran on, or -1
+  struct inode *exeip;         // Executable backing seg[], or 0
+  struct segment seg[MAXSEG];  // Segments paged in from exeip
+  int nseg;
+  struct shmseg *shm[NPROCSHM];  // Shared memory mapped at each window, or 0
+  void (*kfn)(void);           // Body of a kernel process (see kproc), or 0
 };
 
 // Process memory is laid out contiguously, low addresses first:
 //   text
 //   original data and bss
 //   fixed-size stack
-//   expandable heap
\ No newline at end of file
+//   expandable heap
+//   ...
+//   shared memory windows, from SHMBASE to KERNBASE
\ No newline at end of file
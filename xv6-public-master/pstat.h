@@ -0,0 +1,18 @@
+// Snapshot of one process, as copied out by getprocstats().
+struct pstat {
+  int pid;
+  int ppid;                    // 0 for a process without a parent
+  int state;                   // enum procstate
+  uint sz;                     // Size of process memory (bytes)
+  int killed;
+  int lastcpu;                 // CPU it last ran on, or -1
+  char name[16];
+  int queue;                   // enum levels
+  int ticks_used;
+  int burst_time;
+  int creation_time;
+  int enter_queue_time;
+  int last_run_time;
+  int confidence;
+  int used_syscalls[MAX_SYSCALLS];
+};
@@ -0,0 +1,221 @@
+// Shared memory segments.
+//
+// A segment is up to SHMPAGES pages, named by a user-chosen id.
+// The sharedMemory table holds one reference to each frame (the
+// one kalloc() returned) and every process mapping it holds
+// another, counted by kalloc.c as for copy-on-write pages, so a
+// frame is freed only after the table and every mapping let go.
+// A process maps its segments in NPROCSHM fixed windows starting
+// at SHMBASE, above any memory growproc() can hand out.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "spinlock.h"
+
+struct shmseg {
+  int id;
+  int npages;                  // Pages in frame[], 0 if the slot is free
+  int ref_count;               // Processes that have it open
+  char *frame[SHMPAGES];
+};
+
+struct {
+  struct spinlock lock;
+  struct shmseg seg[MAX_SHARED_SEGS];
+} sharedMemory;
+
+void
+init_sharedmem(void)
+{
+  initlock(&sharedMemory.lock, "sharedmem");
+}
+
+// User address of process window w.
+static uint
+window(int w)
+{
+  return SHMBASE + w*SHMPAGES*PGSIZE;
+}
+
+// Drop a process's hold on s; free it when nobody has it open.
+// Caller must hold sharedMemory.lock.
+static void
+put(struct shmseg *s)
+{
+  int i;
+
+  if(--s->ref_count > 0)
+    return;
+  for(i = 0; i < s->npages; i++)
+    kfree(s->frame[i]);
+  s->npages = 0;
+}
+
+// Map segment id into the current process, creating it with
+// npages zeroed pages if it does not exist yet. Returns the
+// address it is mapped at, or 0.
+char*
+open_sharedmem(int id, int npages)
+{
+  struct proc *curproc = myproc();
+  struct shmseg *s, *found;
+  int w, i;
+
+  acquire(&sharedMemory.lock);
+
+  found = 0;
+  for(s = sharedMemory.seg; s < &sharedMemory.seg[MAX_SHARED_SEGS]; s++){
+    if(s->npages > 0 && s->id == id){
+      found = s;
+      break;
+    }
+  }
+
+  if(found){
+    if(npages > found->npages)
+      goto bad;
+    for(w = 0; w < NPROCSHM; w++){
+      if(curproc->shm[w] == found){
+        release(&sharedMemory.lock);
+        return (char*)window(w);
+      }
+    }
+  } else {
+    if(npages <= 0 || npages > SHMPAGES)
+      goto bad;
+    for(s = sharedMemory.seg; s < &sharedMemory.seg[MAX_SHARED_SEGS]; s++)
+      if(s->npages == 0)
+        break;
+    if(s == &sharedMemory.seg[MAX_SHARED_SEGS])
+      goto bad;
+    for(i = 0; i < npages; i++){
+      if((s->frame[i] = kalloc()) == 0){
+        while(--i >= 0)
+          kfree(s->frame[i]);
+        goto bad;
+      }
+      memset(s->frame[i], 0, PGSIZE);
+    }
+    s->id = id;
+    s->npages = npages;
+    s->ref_count = 0;
+    found = s;
+  }
+
+  for(w = 0; w < NPROCSHM; w++)
+    if(curproc->shm[w] == 0)
+      break;
+  if(w == NPROCSHM ||
+     mapshared(curproc->pgdir, window(w), found->frame, found->npages) < 0){
+    if(found->ref_count == 0){
+      found->ref_count = 1;
+      put(found);
+    }
+    goto bad;
+  }
+  found->ref_count++;
+  curproc->shm[w] = found;
+
+  release(&sharedMemory.lock);
+  return (char*)window(w);
+
+ bad:
+  release(&sharedMemory.lock);
+  return 0;
+}
+
+// Unmap segment id from the current process.
+int
+close_sharedmem(int id)
+{
+  struct proc *curproc = myproc();
+  struct shmseg *s;
+  int w;
+
+  acquire(&sharedMemory.lock);
+  for(w = 0; w < NPROCSHM; w++){
+    s = curproc->shm[w];
+    if(s && s->id == id){
+      unmapshared(curproc->pgdir, window(w), s->npages);
+      lcr3(V2P(curproc->pgdir));
+      put(s);
+      curproc->shm[w] = 0;
+      release(&sharedMemory.lock);
+      return 0;
+    }
+  }
+  release(&sharedMemory.lock);
+  return -1;
+}
+
+// Unmap every segment of p. Caller must hold sharedMemory.lock.
+static void
+putall(struct proc *p)
+{
+  int w;
+
+  for(w = 0; w < NPROCSHM; w++){
+    if(p->shm[w] == 0)
+      continue;
+    unmapshared(p->pgdir, window(w), p->shm[w]->npages);
+    put(p->shm[w]);
+    p->shm[w] = 0;
+  }
+}
+
+// Is [va, va+len) inside one of the segments p has mapped?
+// Lets system calls take buffers in shared memory, which lies
+// above p->sz.
+int
+in_sharedmem(struct proc *p, uint va, uint len)
+{
+  int w, ok;
+
+  if(va < SHMBASE || va >= KERNBASE || va + len < va)
+    return 0;
+  w = (va - SHMBASE) / (SHMPAGES*PGSIZE);
+  acquire(&sharedMemory.lock);
+  ok = p->shm[w] != 0 && va + len <= window(w) + p->shm[w]->npages*PGSIZE;
+  release(&sharedMemory.lock);
+  return ok;
+}
+
+// Give child np the parent's segments, at the same addresses.
+int
+fork_sharedmem(struct proc *curproc, struct proc *np)
+{
+  struct shmseg *s;
+  int w;
+
+  acquire(&sharedMemory.lock);
+  for(w = 0; w < NPROCSHM; w++)
+    np->shm[w] = 0;
+  for(w = 0; w < NPROCSHM; w++){
+    if((s = curproc->shm[w]) == 0)
+      continue;
+    if(mapshared(np->pgdir, window(w), s->frame, s->npages) < 0){
+      putall(np);
+      release(&sharedMemory.lock);
+      return -1;
+    }
+    s->ref_count++;
+    np->shm[w] = s;
+  }
+  release(&sharedMemory.lock);
+  return 0;
+}
+
+// Unmap every segment of the current process, on exit or exec.
+void
+exit_sharedmem(struct proc *curproc)
+{
+  acquire(&sharedMemory.lock);
+  putall(curproc);
+  lcr3(V2P(curproc->pgdir));
+  release(&sharedMemory.lock);
+}
@@ -0,0 +1,124 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "param.h"
+#include "trace.h"
+#include "bench.h"
+
+#define WORK 5000000
+#define RR 0
+#define SJF 1
+
+int children = 32;
+int order[2];   // bursts of the finished jobs, in finishing order
+
+// Move to SJF with a burst estimate that shrinks with i, so
+// fork order and burst order disagree, give the other jobs time
+// to do the same, then burn the CPU and report the burst.
+void job(int i)
+{
+    volatile int x = 0;
+    int burst = children - i;
+
+    change_queue(getpid(), SJF);
+    set_initial_burst_confidence(getpid(), burst, 100);
+    sleep(10);
+
+    for(int j = 0; j < WORK; j++)
+        x += j;
+
+    write(order[1], &burst, sizeof(burst));
+}
+
+// Drain the scheduler trace every tick until the file
+// sjf_done appears, and send the number of SJF picks, their
+// total cycles and the slowest one up fd.
+void collect_picks(int fd)
+{
+    struct traceevent *ev = malloc(NCPU * NTRACE * sizeof(struct traceevent));
+    uint stats[3] = { 0, 0, 0 };
+    int done = 0;
+
+    // Throw away whatever was traced before we started.
+    while(trace_read(ev, NCPU * NTRACE) > 0)
+        ;
+
+    while(!done)
+    {
+        int f = open("sjf_done", O_RDONLY);
+        if(f >= 0)
+        {
+            close(f);
+            done = 1;   // one last drain below
+        }
+
+        int n = trace_read(ev, NCPU * NTRACE);
+        for(int i = 0; i < n; i++)
+        {
+            if(ev[i].type != TRACE_SJF_PICK)
+                continue;
+            stats[0]++;
+            stats[1] += ev[i].arg;
+            if(ev[i].arg > stats[2])
+                stats[2] = ev[i].arg;
+        }
+
+        if(!done)
+            sleep(1);
+    }
+
+    write(fd, stats, sizeof(stats));
+}
+
+int main(int argc, char *argv[])
+{
+    benchargs(argc, argv, &children, 1, "sjf_test [children]");
+
+    // Collect the SJF pick timings an SJFBENCH kernel traces,
+    // from a separate process so the ring is drained while the
+    // jobs run.
+    int fds[2];
+    uint picks[3];
+    pipe(fds);
+    unlink("sjf_done");
+    int collector = fork();
+    if(collector == 0)
+    {
+        close(fds[0]);
+        collect_picks(fds[1]);
+        exit();
+    }
+    close(fds[1]);
+    change_queue(collector, RR);
+
+    pipe(order);
+    int makespan = runjobs(children, job);
+    close(order[1]);
+
+    int done = 0, in_order = 0, burst, last_burst = 0;
+
+    while(read(order[0], &burst, sizeof(burst)) == sizeof(burst))
+    {
+        done++;
+        if(burst >= last_burst)
+            in_order++;
+        last_burst = burst;
+    }
+    close(order[0]);
+
+    printf(1, "%d SJF jobs: makespan %d ticks, %d finished in burst order\n",
+           done, makespan, in_order);
+
+    close(open("sjf_done", O_CREATE | O_RDWR));
+    if(read(fds[0], picks, sizeof(picks)) == sizeof(picks) && picks[0] > 0)
+        printf(1, "%d SJF picks: %d cycles on average, %d at most\n",
+               picks[0], picks[1] / picks[0], picks[2]);
+    else
+        printf(1, "no SJF picks traced; build the kernel with SJFBENCH=1 "
+               "to time the heap, SJFBENCH=2 to time the old scan\n");
+    wait();
+    unlink("sjf_done");
+
+    exit();
+}
@@ -6,6 +6,7 @@
 #include "proc.h"
 #include "x86.h"
 #include "syscall.h"
+#include "lathist.h"
 
 // User code makes a system call with INT T_SYSCALL.
 // System call number in %eax.
@@ -21,6 +22,8 @@ fetchint(uint addr, int *ip)
 
   if(addr >= curproc->sz || addr+4 > curproc->sz)
     return -1;
+  if(uvmpagein(curproc, addr, 4, 0) < 0)
+    return -1;
   *ip = *(int*)(addr);
   return 0;
 }
@@ -28,6 +31,7 @@ fetchint(uint addr, int *ip)
 // Fetch the nul-terminated string at addr from the current process.
 // Doesn't actually copy the string - just sets *pp to point at it.
 // Returns length of string, not including nul.
+// Pages the string in one page at a time as it is scanned.
 int
 fetchstr(uint addr, char **pp)
 {
@@ -39,6 +43,9 @@ fetchstr(uint addr, char **pp)
   *pp = (char*)addr;
   ep = (char*)curproc->sz;
   for(s = *pp; s < ep; s++){
+    if((s == *pp || (uint)s % PGSIZE == 0) &&
+       uvmpagein(curproc, (uint)s, 1, 0) < 0)
+      return -1;
     if(*s == 0)
       return s - *pp;
   }
@@ -52,23 +59,46 @@ argint(int n, int *ip)
   return fetchint((myproc()->tf->esp) + 4 + 4*n, ip);
 }
 
-// Fetch the nth word-sized system call argument as a pointer
-// to a block of memory of size bytes.  Check that the pointer
-// lies within the process address space.
-int
-argptr(int n, char **pp, int size)
+static int
+userbuf(int n, char **pp, int size, int write)
 {
   int i;
   struct proc *curproc = myproc();
  
   if(argint(n, &i) < 0)
     return -1;
-  if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
+  if(size < 0)
+    return -1;
+  // Shared memory is always mapped and never copy-on-write.
+  if(in_sharedmem(curproc, i, size)){
+    *pp = (char*)i;
+    return 0;
+  }
+  if((uint)i >= curproc->sz || (uint)i+size > curproc->sz)
+    return -1;
+  if(uvmpagein(curproc, i, size, write) < 0)
     return -1;
   *pp = (char*)i;
   return 0;
 }
 
+// Fetch the nth word-sized system call argument as a pointer
+// to a block of memory of size bytes.  Check that the pointer
+// lies within the process address space, or in a shared memory
+// segment it has mapped, and page the block in.
+int
+argptr(int n, char **pp, int size)
+{
+  return userbuf(n, pp, size, 0);
+}
+
+// Like argptr(), for a buffer the kernel is going to write.
+int
+argptrw(int n, char **pp, int size)
+{
+  return userbuf(n, pp, size, 1);
+}
+
 // Fetch the nth word-sized system call argument as a string pointer.
 // Check that the pointer is valid and the string is nul-terminated.
 // (There is no shared writable memory, so the string can't change
@@ -113,6 +143,15 @@ extern int sys_change_queue(void);
 extern int sys_print_process_information(void);
 extern int sys_get_number_of_total_syscalls(void);
 extern int sys_reentrantlock_test(void);
+extern int sys_get_steal_count(void);
+extern int sys_get_syscall_latency(void);
+extern int sys_getprocstats(void);
+extern int sys_trace_read(void);
+extern int sys_get_free_pages(void);
+extern int sys_open_sharedmem(void);
+extern int sys_close_sharedmem(void);
+extern int sys_fsync(void);
+extern int sys_get_icache_stats(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -146,12 +185,71 @@ static int (*syscalls[])(void) = {
 [SYS_print_process_information] sys_print_process_information,
 [SYS_get_number_of_total_syscalls] sys_get_number_of_total_syscalls,
 [SYS_reentrantlock_test] sys_reentrantlock_test,
+[SYS_get_steal_count] sys_get_steal_count,
+[SYS_get_syscall_latency] sys_get_syscall_latency,
+[SYS_getprocstats] sys_getprocstats,
+[SYS_trace_read] sys_trace_read,
+[SYS_get_free_pages] sys_get_free_pages,
+[SYS_open_sharedmem] sys_open_sharedmem,
+[SYS_close_sharedmem] sys_close_sharedmem,
+[SYS_fsync]   sys_fsync,
+[SYS_get_icache_stats] sys_get_icache_stats,
 };
 
+// used_syscalls[] and the latency histograms have a slot for each
+// call above, numbered from 1. Adding a call past MAX_SYSCALLS
+// must raise it in param.h; this fails to compile until it does.
+typedef char syscalls_fit_max[NELEM(syscalls) - 1 <= MAX_SYSCALLS ? 1 : -1];
+
+// System-wide latency histograms, one per CPU so that
+// recording needs no lock.
+static struct lathist cpulathist[NCPU];
+
+static int
+latbucket(uint64 cycles)
+{
+  int b = 0;
+
+  cycles >>= LATSHIFT + 1;
+  while(cycles != 0 && b < NLATBUCKET - 1) {
+    cycles >>= 1;
+    b++;
+  }
+
+  return b;
+}
+
+// Count one call of num that took the given number of cycles,
+// in the caller's histogram and in this CPU's.
+static void
+record_latency(struct proc *p, int num, uint64 cycles)
+{
+  int b = latbucket(cycles);
+
+  p->lathist->count[num - 1][b]++;
+
+  // The call may have slept and resumed on another CPU.
+  pushcli();
+  cpulathist[cpuid()].count[num - 1][b]++;
+  popcli();
+}
+
+// Copy the system-wide histograms, summed over all CPUs, to h.
+void
+get_system_latency(struct lathist *h)
+{
+  memset(h, 0, sizeof(*h));
+  for(int c = 0; c < NCPU; c++)
+    for(int i = 0; i < MAX_SYSCALLS; i++)
+      for(int b = 0; b < NLATBUCKET; b++)
+        h->count[i][b] += cpulathist[c].count[i][b];
+}
+
 void
 syscall(void)
 {
   int num;
+  uint64 start;
   struct proc *curproc = myproc();
 
   num = curproc->tf->eax;
@@ -160,7 +258,9 @@ syscall(void)
 
     curproc->used_syscalls[num - 1]++;
 
+    start = rdtsc();
     curproc->tf->eax = syscalls[num]();
+    record_latency(curproc, num, rdtsc() - start);
 
   } else {
     cprintf("%d %s: unknown sys call %d\n",
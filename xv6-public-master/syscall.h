@@ -29,4 +29,13 @@
 #define SYS_change_queue 28
 #define SYS_print_process_information 29
 #define SYS_get_number_of_total_syscalls 30
-#define SYS_reentrantlock_test 31
\ No newline at end of file
+#define SYS_reentrantlock_test 31
+#define SYS_get_steal_count 32
+#define SYS_get_syscall_latency 33
+#define SYS_getprocstats 34
+#define SYS_trace_read 35
+#define SYS_get_free_pages 36
+#define SYS_open_sharedmem 37
+#define SYS_close_sharedmem 38
+#define SYS_fsync 39
+#define SYS_get_icache_stats 40
\ No newline at end of file
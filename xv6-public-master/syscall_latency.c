@@ -0,0 +1,107 @@
+// Print p50/p99 system call latencies, in rdtsc cycles,
+// for one process or for the whole system.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "lathist.h"
+
+char *names[] = {
+[1]  "fork",
+[2]  "exit",
+[3]  "wait",
+[4]  "pipe",
+[5]  "read",
+[6]  "kill",
+[7]  "exec",
+[8]  "fstat",
+[9]  "chdir",
+[10] "dup",
+[11] "getpid",
+[12] "sbrk",
+[13] "sleep",
+[14] "uptime",
+[15] "open",
+[16] "write",
+[17] "mknod",
+[18] "unlink",
+[19] "link",
+[20] "mkdir",
+[21] "close",
+[22] "create_palindrome",
+[23] "move_file",
+[24] "sort_syscalls",
+[25] "get_most_invoked",
+[26] "list_all_processes",
+[27] "set_burst_confidence",
+[28] "change_queue",
+[29] "print_process_info",
+[30] "get_total_syscalls",
+[31] "reentrantlock_test",
+[32] "get_steal_count",
+[33] "get_syscall_latency",
+[34] "getprocstats",
+[35] "trace_read",
+[36] "get_free_pages",
+[37] "open_sharedmem",
+[38] "close_sharedmem",
+[39] "fsync",
+[40] "get_icache_stats",
+};
+
+// Upper bound, in cycles, of the bucket holding the given percentile.
+int percentile(uint *count, uint total, int pct)
+{
+    uint seen = 0;
+
+    for(int b = 0; b < NLATBUCKET; b++)
+    {
+        seen += count[b];
+        if(seen * 100 >= total * pct)
+            return 1 << (b + LATSHIFT + 1);
+    }
+
+    return 1 << (NLATBUCKET + LATSHIFT);
+}
+
+int main(int argc, char *argv[])
+{
+    int pid = 0;
+
+    if(argc > 2)
+    {
+        printf(2, "usage: syscall_latency [pid]\n");
+        exit();
+    }
+
+    if(argc > 1)
+        pid = atoi(argv[1]);
+
+    struct lathist *h = malloc(sizeof(*h));
+
+    if(get_syscall_latency(pid, h) < 0)
+    {
+        printf(2, "ERROR: no process with pid %d!\n", pid);
+        exit();
+    }
+
+    printf(1, "syscall / calls / p50 cycles / p99 cycles\n");
+
+    for(int i = 0; i < MAX_SYSCALLS; i++)
+    {
+        uint total = 0;
+
+        for(int b = 0; b < NLATBUCKET; b++)
+            total += h->count[i][b];
+
+        if(total == 0)
+            continue;
+
+        printf(1, "%s / %d / <%d / <%d\n",
+               i + 1 < sizeof(names) / sizeof(names[0]) && names[i + 1] ? names[i + 1] : "?",
+               total, percentile(h->count[i], total, 50), percentile(h->count[i], total, 99));
+    }
+
+    exit();
+}
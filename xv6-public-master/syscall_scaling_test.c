@@ -0,0 +1,27 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "bench.h"
+
+// workers, calls per worker
+int args[] = { 4, 200000 };
+
+// Hammer the cheapest system call there is, so the run is
+// dominated by the syscall entry path.
+void job(int i)
+{
+    for(int j = 0; j < args[1]; j++)
+        getpid();
+}
+
+int main(int argc, char *argv[])
+{
+    benchargs(argc, argv, args, 2, "syscall_scaling_test [workers] [calls]");
+
+    int elapsed = runjobs(args[0], job);
+    printrate(args[0], "workers", args[1], "calls", elapsed);
+
+    get_number_of_total_syscalls();
+
+    exit();
+}
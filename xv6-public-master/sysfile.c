@@ -73,7 +73,7 @@ sys_read(void)
   int n;
   char *p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptrw(1, &p, n) < 0)
     return -1;
   return fileread(f, p, n);
 }
@@ -109,11 +109,41 @@ sys_fstat(void)
   struct file *f;
   struct stat *st;
 
-  if(argfd(0, 0, &f) < 0 || argptr(1, (void*)&st, sizeof(*st)) < 0)
+  if(argfd(0, 0, &f) < 0 || argptrw(1, (void*)&st, sizeof(*st)) < 0)
     return -1;
   return filestat(f, st);
 }
 
+// Wait until everything written so far, to fd's file or any
+// other, is on disk. Writes are otherwise committed by the
+// log a little later, in the background.
+int
+sys_fsync(void)
+{
+  struct file *f;
+
+  if(argfd(0, 0, &f) < 0)
+    return -1;
+  log_sync();
+  return 0;
+}
+
+// Copy out how many inode lookups hit and missed the
+// inode cache since boot.
+int
+sys_get_icache_stats(void)
+{
+  uint *hits, *misses, h, m;
+
+  if(argptrw(0, (void*)&hits, sizeof(*hits)) < 0 ||
+     argptrw(1, (void*)&misses, sizeof(*misses)) < 0)
+    return -1;
+  icachestats(&h, &m);
+  *hits = h;
+  *misses = m;
+  return 0;
+}
+
 // Create the path new as a link to the same inode as old.
 int
 sys_link(void)
@@ -185,7 +215,6 @@ int
 sys_unlink(void)
 {
   struct inode *ip, *dp;
-  struct dirent de;
   char name[DIRSIZ], *path;
   uint off;
 
@@ -215,9 +244,7 @@ sys_unlink(void)
     goto bad;
   }
 
-  memset(&de, 0, sizeof(de));
-  if(writei(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
-    panic("unlink: writei");
+  dirunlink(dp, off);
   if(ip->type == T_DIR){
     dp->nlink--;
     iupdate(dp);
@@ -327,6 +354,8 @@ sys_open(void)
   f->type = FD_INODE;
   f->ip = ip;
   f->off = 0;
+  f->rdend = 0;
+  f->ranext = 0;
   f->readable = !(omode & O_WRONLY);
   f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
   return fd;
@@ -426,7 +455,7 @@ sys_pipe(void)
   struct file *rf, *wf;
   int fd0, fd1;
 
-  if(argptr(0, (void*)&fd, 2*sizeof(fd[0])) < 0)
+  if(argptrw(0, (void*)&fd, 2*sizeof(fd[0])) < 0)
     return -1;
   if(pipealloc(&rf, &wf) < 0)
     return -1;
@@ -446,7 +475,6 @@ sys_pipe(void)
 int 
 sys_move_file(void)
 {
-    struct dirent de; 
     struct inode *src_inode, *dest_inode;
     char *src_file, *dest_dir;
     char filename[DIRSIZ];
@@ -493,18 +521,9 @@ sys_move_file(void)
     }
 
     uint offset;
+    ilock(dp_old);
     struct inode *ip = dirlookup(dp_old, filename, &offset);
     if (ip == 0)
-    {
-      iunlockput(src_inode);
-      iunlockput(dest_inode);
-      end_op();
-      return -1;
-    }
-
-    memset(&de, 0, sizeof(de));
-    ilock(dp_old);
-    if (writei(dp_old, (char*)&de, offset, sizeof(de)) != sizeof(de))
     {
       iunlockput(dp_old);
       iunlockput(src_inode);
@@ -513,9 +532,13 @@ sys_move_file(void)
       return -1;
     }
 
+    dirunlink(dp_old, offset);
+
     iunlockput(dp_old);
     iunlockput(dest_inode);
     iunlockput(src_inode);
+    // ip is src_inode, which was locked until just now.
+    iput(ip);
     end_op();
 
     return 0;
@@ -6,6 +6,9 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "lathist.h"
+#include "pstat.h"
+#include "trace.h"
 
 int
 sys_fork(void)
@@ -170,4 +173,97 @@ sys_reentrantlock_test(void)
     return -1;
 
   return reentrantlock_test(count);
-}
\ No newline at end of file
+}
+
+int
+sys_get_steal_count(void)
+{
+  int cpu;
+
+  if(argint(0, &cpu) < 0)
+    return -1;
+
+  return get_steal_count(cpu);
+}
+
+// Copy the latency histograms of process pid, or the
+// system-wide ones when pid is 0, to the user buffer.
+int
+sys_get_syscall_latency(void)
+{
+  int pid;
+  struct lathist *h;
+
+  if(argint(0, &pid) < 0 || argptrw(1, (void*)&h, sizeof(*h)) < 0)
+    return -1;
+
+  if(pid == 0){
+    get_system_latency(h);
+    return 0;
+  }
+
+  return get_proc_latency(pid, h);
+}
+
+int
+sys_getprocstats(void)
+{
+  int n;
+  struct pstat *ps;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  if(n > NPROC)
+    n = NPROC;
+  if(argptrw(0, (void*)&ps, n * sizeof(*ps)) < 0)
+    return -1;
+
+  return getprocstats((uint)ps, n);
+}
+
+int
+sys_trace_read(void)
+{
+  int n;
+  struct traceevent *ev;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  if(n > NCPU * NTRACE)
+    n = NCPU * NTRACE;
+  if(argptrw(0, (void*)&ev, n * sizeof(*ev)) < 0)
+    return -1;
+
+  return trace_read((uint)ev, n);
+}
+
+int
+sys_get_free_pages(void)
+{
+  return kfreecount();
+}
+
+// Map shared memory segment id, creating it with npages
+// pages if needed. Returns its address, or -1.
+int
+sys_open_sharedmem(void)
+{
+  int id, npages;
+  char *va;
+
+  if(argint(0, &id) < 0 || argint(1, &npages) < 0)
+    return -1;
+  if((va = open_sharedmem(id, npages)) == 0)
+    return -1;
+  return (int)va;
+}
+
+int
+sys_close_sharedmem(void)
+{
+  int id;
+
+  if(argint(0, &id) < 0)
+    return -1;
+  return close_sharedmem(id);
+}
@@ -0,0 +1,93 @@
+// List processes and their scheduler statistics from
+// getprocstats() snapshots, busiest first.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "pstat.h"
+
+char *states[] = { "unused", "embryo", "sleep", "runble", "run", "zombie" };
+char *queues[] = { "RR", "SJF", "FCFS" };
+
+int total_syscalls(struct pstat *ps)
+{
+    int total = 0;
+
+    for(int i = 0; i < MAX_SYSCALLS; i++)
+        total += ps->used_syscalls[i];
+
+    return total;
+}
+
+// Insertion sort on ticks run, longest first.
+void sort_by_run_time(struct pstat *ps, int n)
+{
+    struct pstat tmp;
+
+    for(int i = 1; i < n; i++)
+    {
+        int j = i;
+
+        tmp = ps[i];
+        while(j > 0 && ps[j - 1].last_run_time < tmp.last_run_time)
+        {
+            ps[j] = ps[j - 1];
+            j--;
+        }
+        ps[j] = tmp;
+    }
+}
+
+void show(struct pstat *ps, int n)
+{
+    printf(1, "%d processes, uptime %d ticks\n", n, uptime());
+    printf(1, "PID\tPPID\tSTATE\tQUEUE\tCPU\tRUN\tBURST\tCONF\tCALLS\tSIZE\tNAME\n");
+
+    for(int i = 0; i < n; i++)
+    {
+        printf(1, "%d\t%d\t%s\t%s\t%d\t%d\t%d\t%d\t%d\t%d\t%s\n",
+               ps[i].pid, ps[i].ppid,
+               ps[i].state >= 0 && ps[i].state < 6 ? states[ps[i].state] : "???",
+               ps[i].queue >= 0 && ps[i].queue < 3 ? queues[ps[i].queue] : "???",
+               ps[i].lastcpu, ps[i].last_run_time, ps[i].burst_time,
+               ps[i].confidence, total_syscalls(&ps[i]), ps[i].sz, ps[i].name);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = 1, interval = 100;
+
+    if(argc > 3)
+    {
+        printf(2, "usage: top [rounds] [interval]\n");
+        exit();
+    }
+
+    if(argc > 1)
+        rounds = atoi(argv[1]);
+    if(argc > 2)
+        interval = atoi(argv[2]);
+
+    struct pstat *ps = malloc(NPROC * sizeof(struct pstat));
+
+    for(int r = 0; r < rounds; r++)
+    {
+        if(r > 0)
+            sleep(interval);
+
+        int n = getprocstats(ps, NPROC);
+
+        if(n < 0)
+        {
+            printf(2, "ERROR: getprocstats failed!\n");
+            exit();
+        }
+
+        sort_by_run_time(ps, n);
+        show(ps, n);
+    }
+
+    exit();
+}
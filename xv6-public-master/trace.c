@@ -0,0 +1,91 @@
+// Scheduler event tracing.
+//
+// Each CPU owns one ring of NTRACE events. Only that CPU adds
+// to its ring, with interrupts off, so recording takes no lock
+// and costs a few stores. Readers only advance the tail and are
+// serialized among themselves by tracelock. When a ring is full,
+// new events are dropped until a reader drains it.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "trace.h"
+
+struct tracering {
+  volatile uint head;          // Events ever recorded
+  volatile uint tail;          // Events ever drained
+  struct traceevent ev[NTRACE];
+} __attribute__((aligned(CACHELINE)));
+
+static struct tracering rings[NCPU];
+static struct spinlock tracelock;
+
+void
+traceinit(void)
+{
+  initlock(&tracelock, "trace");
+}
+
+// Record one event in this CPU's ring.
+void
+trace(int type, int pid, int arg)
+{
+  struct tracering *r;
+  struct traceevent *e;
+
+  pushcli();
+  r = &rings[cpuid()];
+  if(r->head - r->tail < NTRACE){
+    e = &r->ev[r->head % NTRACE];
+    e->tsc = rdtsc();
+    e->type = type;
+    e->cpu = cpuid();
+    e->pid = pid;
+    e->arg = arg;
+    // Publish the event before the new head.
+    __sync_synchronize();
+    r->head++;
+  }
+  popcli();
+}
+
+// Move up to n events, ring by ring, to the struct traceevent
+// array at user address addr. Returns the number moved.
+int
+trace_read(uint addr, int n)
+{
+  struct tracering *r;
+  uint head, i, len;
+  int count = 0;
+
+  acquire(&tracelock);
+  for(r = rings; r < &rings[NCPU] && count < n; r++){
+    head = r->head;
+    __sync_synchronize();
+    while(r->tail != head && count < n){
+      i = r->tail % NTRACE;
+      len = head - r->tail;
+      if(len > NTRACE - i)
+        len = NTRACE - i;
+      if(len > n - count)
+        len = n - count;
+      if(copyout(myproc()->pgdir, addr + count * sizeof(struct traceevent),
+                 &r->ev[i], len * sizeof(struct traceevent)) < 0){
+        release(&tracelock);
+        return -1;
+      }
+      // Done reading the slots before handing them back.
+      __sync_synchronize();
+      r->tail += len;
+      count += len;
+    }
+  }
+  release(&tracelock);
+
+  return count;
+}
@@ -0,0 +1,17 @@
+// Scheduler trace events, recorded per CPU by trace()
+// and drained by the trace_read() system call.
+#define TRACE_SWITCH_IN   1  // arg: queue level
+#define TRACE_SWITCH_OUT  2  // arg: state when switched out
+#define TRACE_QUEUE       3  // arg: new queue level, by change_queue()
+#define TRACE_AGING       4  // arg: new queue level, by aging()
+#define TRACE_SLEEP       5  // arg: channel
+#define TRACE_WAKEUP      6  // arg: channel
+#define TRACE_SJF_PICK    7  // arg: cycles an SJF pick took (SJFBENCH builds only)
+
+struct traceevent {
+  uint64 tsc;                  // Time-stamp counter when recorded
+  int type;                    // TRACE_*
+  int cpu;
+  int pid;
+  int arg;
+};
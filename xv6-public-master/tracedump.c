@@ -0,0 +1,86 @@
+// Drain the kernel scheduler trace and print it in time order.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "trace.h"
+
+char *events[] = {
+[TRACE_SWITCH_IN]   "switch-in",
+[TRACE_SWITCH_OUT]  "switch-out",
+[TRACE_QUEUE]       "queue",
+[TRACE_AGING]       "aging",
+[TRACE_SLEEP]       "sleep",
+[TRACE_WAKEUP]      "wakeup",
+[TRACE_SJF_PICK]    "sjf-pick",
+};
+
+// Insertion sort on the time stamp; every CPU's events
+// arrive already in order, so runs are long.
+void sort_by_time(struct traceevent *ev, int n)
+{
+    struct traceevent tmp;
+
+    for(int i = 1; i < n; i++)
+    {
+        int j = i;
+
+        tmp = ev[i];
+        while(j > 0 && ev[j - 1].tsc > tmp.tsc)
+        {
+            ev[j] = ev[j - 1];
+            j--;
+        }
+        ev[j] = tmp;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = 1, interval = 100;
+
+    if(argc > 3)
+    {
+        printf(2, "usage: tracedump [rounds] [interval]\n");
+        exit();
+    }
+
+    if(argc > 1)
+        rounds = atoi(argv[1]);
+    if(argc > 2)
+        interval = atoi(argv[2]);
+
+    struct traceevent *ev = malloc(NCPU * NTRACE * sizeof(struct traceevent));
+
+    for(int r = 0; r < rounds; r++)
+    {
+        if(r > 0)
+            sleep(interval);
+
+        int n = trace_read(ev, NCPU * NTRACE);
+
+        if(n < 0)
+        {
+            printf(2, "ERROR: trace_read failed!\n");
+            exit();
+        }
+
+        sort_by_time(ev, n);
+
+        printf(1, "%d events\nKCYCLES\t+CYCLES\tCPU\tPID\tEVENT\tARG\n", n);
+
+        for(int i = 0; i < n; i++)
+        {
+            uint64 delta = i > 0 ? ev[i].tsc - ev[i - 1].tsc : 0;
+
+            printf(1, "%d\t%d\t%d\t%d\t%s\t%x\n",
+                   (uint)((ev[i].tsc - ev[0].tsc) >> 10), (uint)delta,
+                   ev[i].cpu, ev[i].pid,
+                   ev[i].type > 0 && ev[i].type <= TRACE_WAKEUP ? events[ev[i].type] : "?",
+                   ev[i].arg);
+        }
+    }
+
+    exit();
+}
@@ -13,9 +13,15 @@
 struct gatedesc idt[256];
 extern uint vectors[];  // in vectors.S: array of 256 entry pointers
 struct spinlock tickslock;
-struct spinlock syscallslock;
 uint ticks;
-uint total_number_of_syscalls = 0;
+
+// Weighted system call counts, one per CPU. Each CPU only
+// updates its own slot, with interrupts off, so no lock is
+// needed; the padding keeps the slots on separate cache lines.
+struct syscallcount {
+  uint count;
+  char pad[CACHELINE - sizeof(uint)];
+} __attribute__((aligned(CACHELINE))) syscallcounts[NCPU];
 
 void
 tvinit(void)
@@ -26,8 +32,6 @@ tvinit(void)
     SETGATE(idt[i], 0, SEG_KCODE<<3, vectors[i], 0);
   SETGATE(idt[T_SYSCALL], 1, SEG_KCODE<<3, vectors[T_SYSCALL], DPL_USER);
 
-  mycpu()->number_of_syscalls = 0;
-
   initlock(&tickslock, "time");
 }
 
@@ -60,6 +64,13 @@ print_info()
     cprintf("\n");
 }
 
+// Weighted system call count of one CPU.
+int
+get_cpu_syscalls(int cpu)
+{
+  return syscallcounts[cpu].count;
+}
+
 //PAGEBREAK: 41
 void
 trap(struct trapframe *tf)
@@ -68,20 +79,15 @@ trap(struct trapframe *tf)
     if(myproc()->killed)
       exit();
 
-    acquire(&syscallslock);
-    if(tf->eax == SYS_open) {
-      total_number_of_syscalls += 3;
-      mycpu()->number_of_syscalls += 3;
-    }
-    else if(tf->eax == SYS_write) {
-      total_number_of_syscalls += 2;
-      mycpu()->number_of_syscalls += 2;
-    }
-    else {
-      total_number_of_syscalls += 1;
-      mycpu()->number_of_syscalls += 1;
-    }
-    release(&syscallslock);
+    // pushcli keeps us on this CPU until the slot is updated.
+    pushcli();
+    if(tf->eax == SYS_open)
+      syscallcounts[cpuid()].count += 3;
+    else if(tf->eax == SYS_write)
+      syscallcounts[cpuid()].count += 2;
+    else
+      syscallcounts[cpuid()].count += 1;
+    popcli();
 
     myproc()->tf = tf;
     syscall();
@@ -123,6 +129,17 @@ trap(struct trapframe *tf)
     lapiceoi();
     break;
 
+  case T_PGFLT:
+    // First touch of lazily grown heap, or a write to a
+    // copy-on-write page, from user code. System calls page in
+    // what they read from user memory up front, in fetchint(),
+    // fetchstr() and argptr(), and unshare what they write with
+    // argptrw(), so the kernel should not fault on user memory
+    // while holding a spinlock or run out of memory here.
+    if(myproc() != 0 && uvmfault(myproc(), rcr2(), tf->err) == 0)
+      break;
+    // fall through
+
   //PAGEBREAK: 13
   default:
     if(myproc() == 0 || (tf->cs&3) == 0){
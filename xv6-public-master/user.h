@@ -1,5 +1,8 @@
 struct stat;
 struct rtcdate;
+struct lathist;
+struct pstat;
+struct traceevent;
 
 // system calls
 int fork(void);
@@ -33,6 +36,15 @@ int change_queue(int, int);
 int print_process_information(void);
 int get_number_of_total_syscalls(void);
 int reentrantlock_test(int);
+int get_steal_count(int);
+int get_syscall_latency(int, struct lathist*);
+int getprocstats(struct pstat*, int);
+int trace_read(struct traceevent*, int);
+int get_free_pages(void);
+void* open_sharedmem(int, int);
+int close_sharedmem(int);
+int fsync(int);
+int get_icache_stats(uint*, uint*);
 
 // ulib.c
 int stat(const char*, struct stat*);
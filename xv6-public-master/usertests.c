@@ -1347,8 +1347,7 @@ iref(void)
 
   printf(1, "empty file name\n");
 
-  // the 50 is NINODE
-  for(i = 0; i < 50 + 1; i++){
+  for(i = 0; i < NINODE + 1; i++){
     if(mkdir("irefd") != 0){
       printf(1, "mkdir irefd failed\n");
       exit();
@@ -1383,7 +1382,7 @@ forktest(void)
 
   printf(1, "fork test\n");
 
-  for(n=0; n<1000; n++){
+  for(n=0; n<2000; n++){
     pid = fork();
     if(pid < 0)
       break;
@@ -1391,8 +1390,8 @@ forktest(void)
       exit();
   }
 
-  if(n == 1000){
-    printf(1, "fork claimed to work 1000 times!\n");
+  if(n == 2000){
+    printf(1, "fork claimed to work 2000 times!\n");
     exit();
   }
 
@@ -87,8 +87,9 @@ mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm)
 //
 // setupkvm() and exec() set up every page table like this:
 //
-//   0..KERNBASE: user memory (text+data+stack+heap), mapped to
+//   0..SHMBASE: user memory (text+data+stack+heap), mapped to
 //                phys memory allocated by the kernel
+//   SHMBASE..KERNBASE: shared memory segments (see sharedmem.c)
 //   KERNBASE..KERNBASE+EXTMEM: mapped to 0..EXTMEM (for I/O space)
 //   KERNBASE+EXTMEM..data: mapped to EXTMEM..V2P(data)
 //                for the kernel's instructions and r/o data
@@ -224,7 +225,7 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
   char *mem;
   uint a;
 
-  if(newsz >= KERNBASE)
+  if(newsz >= SHMBASE)
     return 0;
   if(newsz < oldsz)
     return oldsz;
@@ -311,36 +312,242 @@ clearpteu(pde_t *pgdir, char *uva)
 }
 
 // Given a parent process's page table, create a copy
-// of it for a child.
+// of it for a child. Pages are shared copy-on-write:
+// writable pages become read-only PTE_COW pages in both
+// tables, and cowfault() copies one on its first write.
+// pgdir must be the current page table.
 pde_t*
 copyuvm(pde_t *pgdir, uint sz)
 {
   pde_t *d;
   pte_t *pte;
   uint pa, i, flags;
-  char *mem;
 
   if((d = setupkvm()) == 0)
     return 0;
   for(i = 0; i < sz; i += PGSIZE){
+    // Pages not paged in yet stay unmapped in the child too.
     if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
+      continue;
     if(!(*pte & PTE_P))
-      panic("copyuvm: page not present");
+      continue;
+    if(*pte & PTE_W)
+      *pte = (*pte & ~PTE_W) | PTE_COW;
     pa = PTE_ADDR(*pte);
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
-      goto bad;
-    memmove(mem, (char*)P2V(pa), PGSIZE);
-    if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0) {
-      kfree(mem);
+    if(mappages(d, (void*)i, PGSIZE, pa, flags) < 0)
       goto bad;
-    }
+    kincref(P2V(pa));
   }
+  // The parent lost write access to its pages.
+  lcr3(V2P(pgdir));
   return d;
 
 bad:
   freevm(d);
+  lcr3(V2P(pgdir));
+  return 0;
+}
+
+// Handle a write to the copy-on-write page holding va in
+// pgdir: the last sharer takes the page back writable, the
+// others get a private copy. Returns -1 if va is not on a
+// copy-on-write page or no memory is left.
+int
+cowfault(pde_t *pgdir, uint va)
+{
+  pte_t *pte;
+  uint pa;
+  char *mem;
+
+  if(va >= KERNBASE || (pte = walkpgdir(pgdir, (void*)va, 0)) == 0)
+    return -1;
+  if((*pte & PTE_P) == 0 || (*pte & PTE_COW) == 0)
+    return -1;
+
+  pa = PTE_ADDR(*pte);
+  if(krefcount(P2V(pa)) == 1){
+    *pte = (*pte | PTE_W) & ~PTE_COW;
+  } else {
+    if((mem = kalloc()) == 0)
+      return -1;
+    memmove(mem, P2V(pa), PGSIZE);
+    *pte = V2P(mem) | ((PTE_FLAGS(*pte) | PTE_W) & ~PTE_COW);
+    kfree(P2V(pa));
+  }
+  invlpg((void*)va);
+  return 0;
+}
+
+// Map the page holding va, which exec() or growproc() left
+// unmapped. Pages of an ELF segment are read from the
+// executable; whatever the file does not cover is zeroed.
+// May sleep reading the file, so the caller must hold no spinlocks.
+static int
+pagein(struct proc *p, uint va)
+{
+  char *mem;
+  struct segment *s;
+  uint a, n;
+
+  a = PGROUNDDOWN(va);
+  if((mem = kalloc()) == 0)
+    return -1;
+  memset(mem, 0, PGSIZE);
+  for(s = p->seg; s < &p->seg[p->nseg]; s++){
+    if(a < s->va || a >= s->va + s->filesz)
+      continue;
+    n = s->va + s->filesz - a;
+    if(n > PGSIZE)
+      n = PGSIZE;
+    ilock(p->exeip);
+    if(readi(p->exeip, mem, s->off + (a - s->va), n) != n){
+      iunlock(p->exeip);
+      kfree(mem);
+      return -1;
+    }
+    iunlock(p->exeip);
+    break;
+  }
+  if(mappages(p->pgdir, (char*)a, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
+    kfree(mem);
+    return -1;
+  }
+  return 0;
+}
+
+// Resolve a page fault at user address va of process p, with
+// x86 error code err. Returns 0 if the access can be retried.
+int
+uvmfault(struct proc *p, uint va, uint err)
+{
+  pte_t *pte;
+
+  if(va >= p->sz)
+    return -1;
+
+  pte = walkpgdir(p->pgdir, (void*)va, 0);
+  if(pte == 0 || (*pte & PTE_P) == 0)
+    return pagein(p, va);
+  if(err & FEC_WR)
+    return cowfault(p->pgdir, va);
+  return -1;
+}
+
+// Page in every unmapped page of [va, va+len) in p, and if the
+// kernel is going to write the buffer, give p its own copy of
+// every copy-on-write page in it. System calls run this on user
+// buffers before the kernel touches them, since the kernel may
+// do so holding spinlocks, where pagein() can't sleep, and so
+// that running out of memory fails the call rather than a
+// kernel-mode page fault.
+int
+uvmpagein(struct proc *p, uint va, uint len, int write)
+{
+  uint a, last;
+  pte_t *pte;
+
+  if(len == 0)
+    return 0;
+  a = PGROUNDDOWN(va);
+  last = PGROUNDDOWN(va + len - 1);
+  for(;; a += PGSIZE){
+    pte = walkpgdir(p->pgdir, (char*)a, 0);
+    if(pte == 0 || (*pte & PTE_P) == 0){
+      if(pagein(p, a) < 0)
+        return -1;
+    } else if(write && (*pte & PTE_COW) && cowfault(p->pgdir, a) < 0)
+      return -1;
+    if(a == last)
+      break;
+  }
+  return 0;
+}
+
+// Map the n frames frame[] at va, adding a reference to
+// each, so processes can share them.
+int
+mapshared(pde_t *pgdir, uint va, char **frame, int n)
+{
+  int i;
+
+  for(i = 0; i < n; i++){
+    if(mappages(pgdir, (char*)va + i*PGSIZE, PGSIZE,
+                V2P(frame[i]), PTE_W|PTE_U) < 0){
+      unmapshared(pgdir, va, i);
+      return -1;
+    }
+    kincref(frame[i]);
+  }
+  return 0;
+}
+
+// Undo mapshared() for the first n pages at va. The caller
+// flushes the TLB if pgdir is in use.
+void
+unmapshared(pde_t *pgdir, uint va, int n)
+{
+  pte_t *pte;
+  int i;
+
+  for(i = 0; i < n; i++){
+    pte = walkpgdir(pgdir, (char*)va + i*PGSIZE, 0);
+    if(pte && (*pte & PTE_P)){
+      kfree(P2V(PTE_ADDR(*pte)));
+      *pte = 0;
+    }
+  }
+}
+
+// Share the user page at va copy-on-write, so a pipe can hold
+// it instead of a copy. Returns its kernel address, with a
+// reference for the caller, or 0 if the page can't be shared.
+// pgdir must be the current page table.
+char*
+lendpage(pde_t *pgdir, uint va)
+{
+  pte_t *pte;
+  char *mem;
+
+  // Shared memory must stay writable in place.
+  if(va >= SHMBASE)
+    return 0;
+  pte = walkpgdir(pgdir, (char*)va, 0);
+  if(pte == 0 || (*pte & (PTE_P|PTE_U)) != (PTE_P|PTE_U) ||
+     (*pte & (PTE_W|PTE_COW)) == 0)
+    return 0;
+  if(*pte & PTE_W){
+    *pte = (*pte & ~PTE_W) | PTE_COW;
+    invlpg((void*)va);
+  }
+  mem = P2V(PTE_ADDR(*pte));
+  kincref(mem);
+  return mem;
+}
+
+// Map the page *frame at user address va and hand the page it
+// replaces back in *frame, so a pipe can move a page instead
+// of copying it. The user page must be writable and not
+// shared. pgdir must be the current page table.
+int
+swappage(pde_t *pgdir, uint va, char **frame)
+{
+  pte_t *pte;
+  char *old;
+  uint flags;
+
+  pte = walkpgdir(pgdir, (char*)va, 0);
+  if(pte == 0 || (*pte & (PTE_P|PTE_U|PTE_W)) != (PTE_P|PTE_U|PTE_W))
+    return -1;
+  old = P2V(PTE_ADDR(*pte));
+  if(krefcount(old) != 1)
+    return -1;
+  flags = PTE_FLAGS(*pte);
+  if(krefcount(*frame) > 1)
+    flags = (flags & ~PTE_W) | PTE_COW;
+  *pte = V2P(*frame) | flags;
+  *frame = old;
+  invlpg((void*)va);
   return 0;
 }
 
@@ -367,10 +574,20 @@ copyout(pde_t *pgdir, uint va, void *p, uint len)
 {
   char *buf, *pa0;
   uint n, va0;
+  pte_t *pte;
 
   buf = (char*)p;
   while(len > 0){
     va0 = (uint)PGROUNDDOWN(va);
+    // The kernel mapping bypasses the page protections, so
+    // map lazily grown pages and unshare copy-on-write ones first.
+    pte = walkpgdir(pgdir, (char*)va0, 0);
+    if(pte == 0 || (*pte & PTE_P) == 0){
+      if(myproc() == 0 || pgdir != myproc()->pgdir ||
+         uvmfault(myproc(), va0, FEC_WR) < 0)
+        return -1;
+    } else if((*pte & PTE_COW) && cowfault(pgdir, va0) < 0)
+      return -1;
     pa0 = uva2ka(pgdir, (char*)va0);
     if(pa0 == 0)
       return -1;
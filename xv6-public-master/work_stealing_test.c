@@ -0,0 +1,34 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "bench.h"
+
+#define WORK 20000000
+
+// CPU-bound job that never blocks.
+void burn(int i)
+{
+    volatile int x = 0;
+
+    for(int j = 0; j < WORK; j++)
+        x += j;
+}
+
+int main(int argc, char *argv[])
+{
+    int children = 16;
+
+    benchargs(argc, argv, &children, 1, "work_stealing_test [children]");
+
+    int single = runjobs(1, burn);
+
+    int steals = get_steal_count(-1);
+    int makespan = runjobs(children, burn);
+    steals = get_steal_count(-1) - steals;
+
+    printf(1, "one job: %d ticks\n", single);
+    printf(1, "%d jobs: makespan %d ticks, serial estimate %d ticks, %d steals\n",
+           children, makespan, single * children, steals);
+
+    exit();
+}
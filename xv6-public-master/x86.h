@@ -105,6 +105,16 @@ loadgs(ushort v)
   asm volatile("movw %0, %%gs" : : "r" (v));
 }
 
+// Read the CPU time-stamp counter.
+static inline uint64
+rdtsc(void)
+{
+  uint64 val;
+
+  asm volatile("rdtsc" : "=A" (val));
+  return val;
+}
+
 static inline void
 cli(void)
 {
@@ -138,6 +148,13 @@ rcr2(void)
   return val;
 }
 
+// Drop the TLB entry for the page holding va.
+static inline void
+invlpg(void *va)
+{
+  asm volatile("invlpg (%0)" : : "r" (va) : "memory");
+}
+
 static inline void
 lcr3(uint val)
 {